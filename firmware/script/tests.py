@@ -27,6 +27,10 @@ Wrap src/ code to skip in UNIT_TEST guards:
 #endif // UNIT_TEST
 ```
 
+Code which only touches hardware through the Arduino core (e.g. SmartPlug)
+can instead run against the host stand-ins in test/sim, see
+test/hlw8012_sim.h.
+
 """
 
 import os
@@ -122,7 +126,12 @@ bld = Builder(action=builder_unit_test)
 test_env.Append(BUILDERS={'Test': bld})
 
 # tests
-program = test_env.Program(os.path.join(project_build_dir, 'tests'), [
+# test/sim stands in for the Arduino core (Arduino.h) so SmartPlug can run
+# against a simulated HLW8012, only the test program sees it (not arduino_lib)
+sim_env = test_env.Clone()
+sim_env.Prepend(CPPPATH=[os.path.join(test_env['PROJECT_TEST_DIR'], 'sim')])
+
+program = sim_env.Program(os.path.join(project_build_dir, 'tests'), [
     Glob(os.path.join(test_env['PROJECT_TEST_DIR'], '*.cpp')),
     Glob(os.path.join(test_env['PROJECT_SRC_DIR'], '*.cpp')),
 ], LIBS = [arduino_lib])
@@ -0,0 +1,67 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Adaptive measurement publishing cadence
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "cadence.h"
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+Cadence::Cadence()
+: minMillis_(DEFAULT_MIN_MILLIS)
+, maxMillis_(DEFAULT_MAX_MILLIS)
+, interval_(DEFAULT_MIN_MILLIS)
+{ }
+
+/////////////////////////////////////////////////////////////////////////////
+/// change intervals (clamped to limits)
+void Cadence::setIntervals(uint32_t minMillis, uint32_t maxMillis) {
+    if (minMillis < LIMIT_MIN_MILLIS) minMillis = LIMIT_MIN_MILLIS;
+    if (minMillis > LIMIT_MAX_MILLIS) minMillis = LIMIT_MAX_MILLIS;
+    if (maxMillis < minMillis) maxMillis = minMillis;
+    if (maxMillis > LIMIT_MAX_MILLIS) maxMillis = LIMIT_MAX_MILLIS;
+
+    minMillis_ = minMillis;
+    maxMillis_ = maxMillis;
+    interval_ = minMillis;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// new power measurement, checking for a step since the last publish
+void Cadence::measured(uint32_t milliWatts) {
+    latest_ = milliWatts;
+    if (isStep(milliWatts, published_)) step_ = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// is publishing due?
+/// @returns true if measurements should be published now
+bool Cadence::due(unsigned long nowMillis) {
+    const auto elapsed = nowMillis - lastMillis_;
+    if (elapsed < minMillis_) return false;
+
+    if (step_) {
+        // restart back-off
+        step_ = false;
+        interval_ = minMillis_;
+    } else {
+        if (elapsed < interval_) return false;
+        interval_ = (interval_ > maxMillis_ / 2) ? maxMillis_ : interval_ * 2;
+    }
+
+    lastMillis_ = nowMillis;
+    published_ = latest_;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// does milliWatts differ significantly from reference?
+bool Cadence::isStep(uint32_t milliWatts, uint32_t reference) {
+    const auto change = (milliWatts > reference) ? milliWatts - reference : reference - milliWatts;
+    const auto relative = uint64_t{reference} * STEP_PERCENT / 100;
+    return change > STEP_MILLIWATTS && change > relative;
+}
@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Adaptive measurement publishing cadence
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__CADENCE
+#define INCLUDED__CADENCE
+
+//- includes
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// decides when measurements are published
+///
+/// A step in power (load switching on/off) is published as soon as the
+/// minimum interval allows. While the load is steady, each publish doubles
+/// the interval up to the maximum, so an idle plug isn't chattering away.
+class Cadence {
+public:
+    enum : uint32_t {
+        LIMIT_MIN_MILLIS    = 100,      ///< shortest allowed interval
+        LIMIT_MAX_MILLIS    = 60000,    ///< longest allowed interval
+        DEFAULT_MIN_MILLIS  = 100,      ///< default minimum interval
+        DEFAULT_MAX_MILLIS  = 5000,     ///< default maximum (steady) interval
+
+        STEP_MILLIWATTS     = 2000,     ///< power change considered a step
+        STEP_PERCENT        = 10,       ///< relative power change considered a step
+    };
+
+    Cadence();
+
+    void setIntervals(uint32_t minMillis, uint32_t maxMillis);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// minimum interval (ms)
+    uint32_t minMillis() const { return minMillis_; }
+    /// maximum interval (ms)
+    uint32_t maxMillis() const { return maxMillis_; }
+    /// current interval (ms)
+    uint32_t interval() const { return interval_; }
+
+    void measured(uint32_t milliWatts);
+    bool due(unsigned long nowMillis);
+
+    static bool isStep(uint32_t milliWatts, uint32_t reference);
+
+private:
+    uint32_t        minMillis_;             ///< minimum interval
+    uint32_t        maxMillis_;             ///< maximum interval
+    uint32_t        interval_;              ///< current interval
+    uint32_t        latest_{0};             ///< latest measured power (mW)
+    uint32_t        published_{0};          ///< last published power (mW)
+    unsigned long   lastMillis_{0};         ///< last publish
+    bool            step_{false};           ///< step awaiting publish
+};
+
+#endif // INCLUDED__CADENCE
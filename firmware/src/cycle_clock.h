@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Extends a wrapping 32-bit counter to 64-bits
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__CYCLE_CLOCK
+#define INCLUDED__CYCLE_CLOCK
+
+//- includes
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// extends 32-bit CPU cycle counts (CCOUNT) to 64-bits
+///
+/// CCOUNT wraps every ~53 s at 80 MHz (~26 s at 160 MHz). Counts are
+/// extended relative to the last extended count as a signed difference,
+/// so counts may arrive slightly out of order (e.g. edges captured before
+/// the main loop last sampled CCOUNT) provided everything is within half
+/// a wrap period of each other.
+class CycleClock {
+public:
+    /////////////////////////////////////////////////////////////////////////
+    /// constructor
+    explicit CycleClock(uint32_t cycles = 0) { reset(cycles); }
+
+    /// restart extending from cycles
+    /// starts one wrap period in so that earlier counts remain positive
+    void reset(uint32_t cycles) {
+        last_ = (uint64_t{1} << 32) + cycles;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// extend a 32-bit count
+    uint64_t extend(uint32_t cycles) {
+        last_ += static_cast<int32_t>(cycles - static_cast<uint32_t>(last_));
+        return last_;
+    }
+
+    /// last extended count
+    uint64_t last() const { return last_; }
+
+private:
+    uint64_t    last_{0};   ///< last extended count
+};
+
+#endif // INCLUDED__CYCLE_CLOCK
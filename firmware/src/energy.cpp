@@ -0,0 +1,64 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Energy accumulator
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "energy.h"
+#include "hlw8012.h"
+
+constexpr uint64_t Energy::MICROJOULES_PER_WH;
+
+/////////////////////////////////////////////////////////////////////////////
+/// accumulate CF pulses
+void Energy::addPulses(uint32_t pulses) {
+    const auto microJoules = pulses * hlw8012::MICROJOULES_PER_PULSE;
+    total_ += microJoules;
+    today_ += microJoules;
+    unsaved_ += microJoules;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// update current day, restarting today's energy when it changes
+void Energy::setDay(uint32_t day) {
+    if (0 == day || day_ == day) return;
+
+    // energy accumulated before the day was known counts towards today
+    if (0 != day_) {
+        today_ = 0;
+        dayChanged_ = true;
+    }
+    day_ = day;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// restore previously saved energy
+void Energy::restore(double totalWh, double todayWh, uint32_t day) {
+    total_ = (totalWh > 0) ? static_cast<uint64_t>(totalWh * MICROJOULES_PER_WH) : 0;
+    today_ = (todayWh > 0) ? static_cast<uint64_t>(todayWh * MICROJOULES_PER_WH) : 0;
+    day_ = day;
+    unsaved_ = 0;
+    dayChanged_ = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// is saving due?
+bool Energy::saveDue(unsigned long nowMillis) const {
+    if (dayChanged_) return true;
+    if (0 == unsaved_) return false;
+
+    const auto elapsed = nowMillis - lastSaveMillis_;
+    if (elapsed >= SAVE_MAX_MILLIS) return true;
+    return elapsed >= SAVE_MIN_MILLIS && unsaved_ >= SAVE_MIN_WH * MICROJOULES_PER_WH;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// indicate energy was saved
+void Energy::saved(unsigned long nowMillis) {
+    lastSaveMillis_ = nowMillis;
+    unsaved_ = 0;
+    dayChanged_ = false;
+}
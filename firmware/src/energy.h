@@ -0,0 +1,62 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Energy accumulator
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__ENERGY
+#define INCLUDED__ENERGY
+
+//- includes
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// accumulates energy from HLW8012 CF pulses
+///
+/// Each CF pulse is a fixed quantity of energy, so counting pulses
+/// integrates power exactly, regardless of how often (or whether) power
+/// readings are published. Energy is held in integer microjoules.
+///
+/// Saving is wear-aware: pending energy is saved once it exceeds
+/// SAVE_MIN_WH and SAVE_MIN_MILLIS have passed, or after SAVE_MAX_MILLIS
+/// regardless, or promptly after the day rolls over. Anything unsaved at
+/// power loss is lost, bounding the loss to ~SAVE_MIN_WH or an hour.
+class Energy {
+public:
+    enum : uint32_t {
+        SAVE_MIN_MILLIS = 10 * 60 * 1000,   ///< minimum time between saves
+        SAVE_MAX_MILLIS = 60 * 60 * 1000,   ///< save pending energy at least this often
+        SAVE_MIN_WH     = 10,               ///< pending energy worth saving early
+    };
+
+    /// microjoules per watt hour
+    static constexpr uint64_t MICROJOULES_PER_WH = 3600ull * 1000000;
+
+    void addPulses(uint32_t pulses);
+    void setDay(uint32_t day);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// total energy (Wh)
+    double totalWh() const { return double(total_) / MICROJOULES_PER_WH; }
+    /// energy today (Wh)
+    double todayWh() const { return double(today_) / MICROJOULES_PER_WH; }
+    /// current day (days since epoch, 0 = unknown)
+    uint32_t day() const { return day_; }
+
+    void restore(double totalWh, double todayWh, uint32_t day);
+
+    /////////////////////////////////////////////////////////////////////////
+    bool saveDue(unsigned long nowMillis) const;
+    void saved(unsigned long nowMillis);
+
+private:
+    uint64_t        total_{0};              ///< total energy (uJ)
+    uint64_t        today_{0};              ///< energy today (uJ)
+    uint64_t        unsaved_{0};            ///< energy accumulated since last save (uJ)
+    uint32_t        day_{0};                ///< current day (0 = unknown)
+    unsigned long   lastSaveMillis_{0};     ///< last save
+    bool            dayChanged_{false};     ///< day rolled over since last save
+};
+
+#endif // INCLUDED__ENERGY
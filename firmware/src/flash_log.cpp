@@ -0,0 +1,228 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Flash backed circular log of per minute measurements
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "flash_log.h"
+#include <cstring>
+
+namespace {
+    /// 1 s samples per record
+    const uint8_t SAMPLES_PER_RECORD = 60;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+FlashLog::FlashLog(FlashLogStorage& storage)
+: storage_(storage)
+{ }
+
+/////////////////////////////////////////////////////////////////////////////
+/// recover the log's write position
+void FlashLog::begin() {
+    started_ = false;
+    head_ = 0;
+    headSeq_ = 0;
+    next_ = 0;
+
+    const auto sectors = storage_.sectors();
+    if (0 == sectors) return;
+
+    uint32_t seq0 = 0;
+    if (sequence_(0, seq0)) {
+        // sectors up to the newest follow on from sector 0
+        uint32_t lo = 0;
+        uint32_t hi = sectors - 1;
+        while (lo < hi) {
+            const auto mid = lo + (hi - lo + 1) / 2;
+            uint32_t seq = 0;
+            if (sequence_(mid, seq) && seq - seq0 == mid) {
+                lo = mid;
+            } else {
+                hi = mid - 1;
+            }
+        }
+        head_ = lo;
+        headSeq_ = seq0 + lo;
+    } else {
+        // sector 0 was being erased as the log wrapped around
+        if (!sequence_(sectors - 1, headSeq_)) return; // empty
+        head_ = sectors - 1;
+    }
+    started_ = true;
+
+    // first unwritten record within the newest sector
+    uint32_t lo = 0;
+    uint32_t hi = RECORDS_PER_SECTOR;
+    while (lo < hi) {
+        const auto mid = lo + (hi - lo) / 2;
+        if (recordWritten_(head_, mid)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    next_ = lo;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// add a 1 s sample, appending a record each minute
+void FlashLog::add(uint32_t time, const HistorySample& sample) {
+    sumDeciWatts_ += sample.deciWatts;
+    sumDeciVolts_ += sample.deciVolts;
+    if (sample.deciWatts > maxDeciWatts_) maxDeciWatts_ = sample.deciWatts;
+    if (++samples_ < SAMPLES_PER_RECORD) return;
+
+    Record record{};
+    record.time = time;
+    record.deciWatts = static_cast<uint16_t>((sumDeciWatts_ + samples_ / 2) / samples_);
+    record.deciWattsMax = maxDeciWatts_;
+    record.deciVolts = static_cast<uint16_t>((sumDeciVolts_ + samples_ / 2) / samples_);
+
+    sumDeciWatts_ = 0;
+    sumDeciVolts_ = 0;
+    maxDeciWatts_ = 0;
+    samples_ = 0;
+
+    append(record);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// append a record
+/// @returns true on success
+bool FlashLog::append(Record record) {
+    if (ERASED_TIME == record.time) record.time = 0;
+    record.reserved = 0xFF;
+    record.check = checksum(record);
+
+    if (!started_ || next_ >= RECORDS_PER_SECTOR) {
+        if (!startSector_()) return false;
+    }
+
+    const auto offset = HEADER_SIZE + next_ * sizeof(Record);
+    ++next_; // skip over the record, even if writing fails
+    return storage_.write(head_, offset, &record, sizeof(record));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// checksum of a record
+uint8_t FlashLog::checksum(const Record& record) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&record);
+    uint8_t check = 0x5A; // differs from an erased record
+    for (size_t i = 0; i < offsetof(Record, check); ++i) {
+        check = static_cast<uint8_t>((check << 1 | check >> 7) ^ bytes[i]);
+    }
+    return check;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read sector's sequence number
+/// @returns false if the sector doesn't hold a valid header
+bool FlashLog::sequence_(uint32_t sector, uint32_t& sequence) const {
+    SectorHeader header;
+    if (!storage_.read(sector, 0, &header, sizeof(header))) return false;
+    if (MAGIC != header.magic) return false;
+    sequence = header.sequence;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// has record been written?
+bool FlashLog::recordWritten_(uint32_t sector, uint32_t index) const {
+    uint32_t time = 0;
+    if (!storage_.read(sector, HEADER_SIZE + index * sizeof(Record), &time, sizeof(time))) return false;
+    return ERASED_TIME != time;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// erase and begin the next sector
+bool FlashLog::startSector_() {
+    const auto sectors = storage_.sectors();
+    if (0 == sectors) return false;
+
+    const auto sector = (started_) ? (head_ + 1) % sectors : 0;
+    const auto sequence = (started_) ? headSeq_ + 1 : 0;
+    if (!storage_.erase(sector)) return false;
+
+    SectorHeader header;
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = MAGIC;
+    header.sequence = sequence;
+    if (!storage_.write(sector, 0, &header, sizeof(header))) return false;
+
+    head_ = sector;
+    headSeq_ = sequence;
+    next_ = 0;
+    started_ = true;
+    return true;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+FlashLog::Reader::Reader(const FlashLog& log)
+: log_(log)
+{
+    if (!log_.started_) return;
+
+    // sector sequence numbers are consecutive, ending with the newest
+    // (sectors not matching their expected sequence, e.g. one being erased, are skipped)
+    const auto sectors = log_.storage_.sectors();
+    remaining_ = (log_.headSeq_ < sectors) ? log_.headSeq_ + 1 : sectors;
+    sector_ = (log_.head_ + sectors + 1 - remaining_) % sectors;
+    sequence_ = log_.headSeq_ + 1 - remaining_;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read next record
+/// @returns false when there are no more records
+bool FlashLog::Reader::next(Record& record) {
+    const auto sectors = log_.storage_.sectors();
+    while (remaining_ > 0) {
+        if (!checked_) {
+            uint32_t seq = 0;
+            checked_ = log_.sequence_(sector_, seq) && seq == sequence_;
+        }
+        if (checked_ && index_ < RECORDS_PER_SECTOR
+            && log_.headSeq_ - sequence_ < sectors // not since overwritten
+            && log_.storage_.read(sector_, HEADER_SIZE + index_ * sizeof(Record), &record, sizeof(record))
+            && ERASED_TIME != record.time
+        ) {
+            ++index_;
+            if (checksum(record) == record.check) return true;
+            continue;
+        }
+
+        // move onto next sector
+        sector_ = (sector_ + 1) % sectors;
+        ++sequence_;
+        index_ = 0;
+        checked_ = false;
+        --remaining_;
+    }
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read records as bytes (for streaming)
+/// @returns bytes read, 0 at the end of the log
+size_t FlashLog::Reader::read(uint8_t* buffer, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        if (pendingOfs_ >= sizeof(Record)) {
+            if (!next(pending_)) break;
+            pendingOfs_ = 0;
+        }
+
+        auto len = sizeof(Record) - pendingOfs_;
+        if (len > size - total) len = size - total;
+        memcpy(buffer + total, reinterpret_cast<const uint8_t*>(&pending_) + pendingOfs_, len);
+        pendingOfs_ += len;
+        total += len;
+    }
+    return total;
+}
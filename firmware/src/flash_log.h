@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Flash backed circular log of per minute measurements
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__FLASH_LOG
+#define INCLUDED__FLASH_LOG
+
+//- includes
+#include "history_block.h"
+#include <cstddef>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// sectors backing a FlashLog
+/// behaves as NOR flash, writes can only clear bits of erased (0xFF) bytes
+class FlashLogStorage {
+public:
+    enum : uint32_t {
+        SECTOR_SIZE = 4096,     ///< erasable unit
+    };
+
+    virtual ~FlashLogStorage() = default;
+
+    /// number of sectors
+    virtual uint32_t sectors() const = 0;
+    /// erase sector (to 0xFF)
+    virtual bool erase(uint32_t sector) = 0;
+    /// read from within a sector
+    virtual bool read(uint32_t sector, uint32_t offset, void* data, uint32_t size) const = 0;
+    /// write to within a sector
+    virtual bool write(uint32_t sector, uint32_t offset, const void* data, uint32_t size) = 0;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+/// per minute measurement record, as stored
+struct FlashLogRecord {
+    uint32_t    time;           ///< UNIX time at the end of the minute (0 = unknown)
+    uint16_t    deciWatts;      ///< average power (0.1 W)
+    uint16_t    deciWattsMax;   ///< maximum power (0.1 W)
+    uint16_t    deciVolts;      ///< average voltage (0.1 V)
+    uint8_t     reserved;       ///< 0xFF
+    uint8_t     check;          ///< checksum of the preceding bytes
+};
+
+/////////////////////////////////////////////////////////////////////////////
+/// append-only circular log of per minute measurements
+///
+/// The log fills sectors in order, wrapping around to erase the oldest.
+/// Each sector begins with a header holding a sequence number, followed by
+/// fixed size records written in order. So each sector is erased once per
+/// pass around the log, and is only ever written sequentially.
+///
+/// On boot, the newest sector is found by binary search over the sector
+/// headers (sequence numbers increase with the sector index up to the
+/// newest), then the next free record within it by binary search.
+///
+/// Records are streamed from oldest to newest by Reader, as stored
+/// (little-endian FlashLogRecord). Records failing their checksum (e.g.
+/// interrupted by power loss) are skipped. Reader checks each sector's
+/// header once, the log overwriting a sector while it's being read is
+/// apparent from the log's (in memory) head sequence.
+class FlashLog {
+public:
+    using Record = FlashLogRecord;
+
+    enum : uint32_t {
+        MAGIC               = 0x4C475053,   ///< sector header magic ("SPGL")
+        HEADER_SIZE         = 16,           ///< sector header size
+        RECORDS_PER_SECTOR  = (FlashLogStorage::SECTOR_SIZE - HEADER_SIZE) / sizeof(Record),
+        ERASED_TIME         = 0xFFFFFFFF,   ///< time of an unwritten record
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    /// streams records from oldest to newest
+    class Reader {
+    public:
+        explicit Reader(const FlashLog& log);
+
+        bool next(Record& record);
+        size_t read(uint8_t* buffer, size_t size);
+
+    private:
+        const FlashLog& log_;           ///< log being read
+        uint32_t        sector_{0};     ///< current sector
+        uint32_t        sequence_{0};   ///< expected sequence of current sector
+        uint32_t        index_{0};      ///< next record within sector
+        uint32_t        remaining_{0};  ///< sectors remaining (including current)
+        bool            checked_{false}; ///< current sector's header holds sequence_
+        Record          pending_{};     ///< partially read record
+        uint32_t        pendingOfs_{sizeof(Record)}; ///< read offset into pending_
+    };
+
+    explicit FlashLog(FlashLogStorage& storage);
+
+    FlashLog(const FlashLog&) = delete;
+    FlashLog& operator=(const FlashLog&) = delete;
+
+    void begin();
+
+    void add(uint32_t time, const HistorySample& sample);
+    bool append(Record record);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// newest sector
+    uint32_t head() const { return head_; }
+    /// sequence number of the newest sector
+    uint32_t headSequence() const { return headSeq_; }
+    /// records within the newest sector
+    uint32_t headRecords() const { return next_; }
+    /// log holds records
+    bool empty() const { return !started_; }
+
+    static uint8_t checksum(const Record& record);
+
+private:
+    /// sector header, as stored
+    struct SectorHeader {
+        uint32_t    magic;          ///< MAGIC
+        uint32_t    sequence;       ///< increments with each sector written
+        uint32_t    reserved[2];    ///< 0xFF
+    };
+
+    bool sequence_(uint32_t sector, uint32_t& sequence) const;
+    bool recordWritten_(uint32_t sector, uint32_t index) const;
+    bool startSector_();
+
+    FlashLogStorage&    storage_;               ///< backing storage
+    uint32_t            head_{0};               ///< newest sector
+    uint32_t            headSeq_{0};            ///< sequence number of the newest sector
+    uint32_t            next_{0};               ///< next record within the newest sector
+    bool                started_{false};        ///< log holds a sector
+
+    uint32_t            sumDeciWatts_{0};       ///< minute being aggregated
+    uint32_t            sumDeciVolts_{0};       ///< minute being aggregated
+    uint16_t            maxDeciWatts_{0};       ///< minute being aggregated
+    uint8_t             samples_{0};            ///< samples within minute
+};
+
+static_assert(sizeof(FlashLogRecord) == 12, "unexpected FlashLogRecord size");
+
+#endif // INCLUDED__FLASH_LOG
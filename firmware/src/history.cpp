@@ -0,0 +1,87 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Multi-resolution measurement history
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "history.h"
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+History::History()
+: levels_{
+    { seconds_, SECONDS_BLOCKS, 1,    0, 1, 0, 0, 0, 0 },
+    { minutes_, MINUTES_BLOCKS, 60,   0, 1, 0, 0, 0, 0 },
+    { hours_,   HOURS_BLOCKS,   3600, 0, 1, 0, 0, 0, 0 },
+}
+{ }
+
+/////////////////////////////////////////////////////////////////////////////
+/// add a 1 s sample
+void History::add(float watts, float volts) {
+    add(Sample{ toDeci(watts), toDeci(volts) });
+}
+void History::add(const Sample& sample) {
+    push_(0, sample);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// oldest sample held
+uint32_t History::begin(size_t level) const {
+    const auto& l = levels_[level];
+    return l.blocks[(l.head + l.size + 1 - l.used) % l.size].start();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// retrieve a sample (prefer read() for consecutive samples)
+/// @param seq sequence number, within [begin(), end())
+History::Sample History::at(size_t level, uint32_t seq) const {
+    Sample result{};
+    read(level, seq, 1, [&result](uint32_t, const Sample& sample) {
+        result = sample;
+    });
+    return result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// convert to 0.1 units, saturating
+uint16_t History::toDeci(float value) {
+    if (!(value > 0)) return 0;
+    if (value >= UINT16_MAX / 10.0f) return UINT16_MAX;
+    return static_cast<uint16_t>(value * 10 + 0.5f);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// add sample to level, cascading averages into the coarser levels
+void History::push_(size_t level, const Sample& sample) {
+    auto& l = levels_[level];
+    if (!l.blocks[l.head].append(sample)) {
+        // start next block, dropping the oldest when full
+        l.head = (l.head + 1) % l.size;
+        if (l.used < l.size) ++l.used;
+
+        auto& block = l.blocks[l.head];
+        block.reset(l.end);
+        block.append(sample);
+    }
+    ++l.end;
+
+    if (level + 1 >= LEVELS) return;
+
+    auto& next = levels_[level + 1];
+    next.sumDeciWatts += sample.deciWatts;
+    next.sumDeciVolts += sample.deciVolts;
+    if (++next.pending < next.interval / l.interval) return;
+
+    const Sample average{
+        static_cast<uint16_t>((next.sumDeciWatts + next.pending / 2) / next.pending),
+        static_cast<uint16_t>((next.sumDeciVolts + next.pending / 2) / next.pending),
+    };
+    next.sumDeciWatts = 0;
+    next.sumDeciVolts = 0;
+    next.pending = 0;
+    push_(level + 1, average);
+}
@@ -0,0 +1,108 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Multi-resolution measurement history
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__HISTORY
+#define INCLUDED__HISTORY
+
+//- includes
+#include "history_block.h"
+#include <cstddef>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// power and voltage history held in RAM at several resolutions
+///
+/// Samples are added each second and averaged into the coarser levels as
+/// they arrive (1 s, 1 min and 1 h resolutions).
+///
+/// Each level is a ring of compressed blocks (see HistoryBlock), dropping
+/// its oldest block when full, so how far back a level reaches depends on
+/// how well its samples compress. A steady load packs ~190 samples per
+/// block (1 s for over an hour, 1 min for ~12 days and 1 h for ~6 months),
+/// a typical varying load around half that, in the RAM a plain 1 s ring
+/// of floats would use for ~20 minutes.
+///
+/// Each level numbers its samples sequentially from boot. Sequence numbers
+/// remain valid while samples are dropped from the front of a level, so
+/// clients can page through a level, or resume from where they left off.
+class History {
+public:
+    /// compact sample
+    using Sample = HistorySample;
+
+    enum : uint32_t {
+        LEVELS          = 3,    ///< number of resolutions
+        SECONDS_BLOCKS  = 24,   ///< 1 s sample blocks
+        MINUTES_BLOCKS  = 90,   ///< 1 min sample blocks
+        HOURS_BLOCKS    = 24,   ///< 1 h sample blocks
+    };
+
+    History();
+
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    void add(float watts, float volts);
+    void add(const Sample& sample);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// seconds between samples
+    uint32_t interval(size_t level) const { return levels_[level].interval; }
+    /// oldest sample held
+    uint32_t begin(size_t level) const;
+    /// sequence number following the newest sample
+    uint32_t end(size_t level) const { return levels_[level].end; }
+
+    Sample at(size_t level, uint32_t seq) const;
+
+    /////////////////////////////////////////////////////////////////////////
+    /// decode up to count samples from start, calling func(seq, sample)
+    template <typename Func>
+    void read(size_t level, uint32_t start, uint32_t count, Func func) const {
+        const auto& l = levels_[level];
+        const auto stop = start + count;
+
+        // blocks from oldest to newest
+        for (uint32_t i = 0; i < l.used && start < stop; ++i) {
+            const auto& block = l.blocks[(l.head + l.size + 1 - l.used + i) % l.size];
+            if (block.end() <= start) continue;
+
+            HistoryBlock::Decoder decoder{block};
+            Sample sample;
+            for (auto seq = block.start(); seq < stop && decoder.next(sample); ++seq) {
+                if (seq < start) continue;
+                func(seq, sample);
+                start = seq + 1;
+            }
+        }
+    }
+
+    static uint16_t toDeci(float value);
+
+private:
+    /// samples at a resolution
+    struct Level {
+        HistoryBlock* blocks;       ///< storage
+        uint32_t    size;           ///< number of blocks
+        uint32_t    interval;       ///< seconds between samples
+        uint32_t    head;           ///< block being appended to
+        uint32_t    used;           ///< blocks holding samples
+        uint32_t    end;            ///< next sequence number
+        uint32_t    sumDeciWatts;   ///< pending average (from the finer level)
+        uint32_t    sumDeciVolts;   ///< pending average (from the finer level)
+        uint32_t    pending;        ///< samples accumulated towards the next average
+    };
+
+    void push_(size_t level, const Sample& sample);
+
+    HistoryBlock    seconds_[SECONDS_BLOCKS];   ///< 1 s samples
+    HistoryBlock    minutes_[MINUTES_BLOCKS];   ///< 1 min samples
+    HistoryBlock    hours_[HOURS_BLOCKS];       ///< 1 h samples
+    Level           levels_[LEVELS];            ///< resolutions, finest first
+};
+
+#endif // INCLUDED__HISTORY
@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Compressed block of measurement history samples
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "history_block.h"
+
+namespace {
+    /// zig-zag encode the (wrapping) difference between two values
+    /// small differences of either sign become small positive numbers
+    inline uint16_t zigZag(uint16_t prev, uint16_t value) {
+        const auto delta = static_cast<uint16_t>(value - prev);
+        return static_cast<uint16_t>((delta << 1) ^ (0 - (delta >> 15)));
+    }
+    /// reverse zigZag
+    inline uint16_t unZigZag(uint16_t prev, uint16_t zz) {
+        const auto delta = static_cast<uint16_t>((zz >> 1) ^ (0 - (zz & 1)));
+        return static_cast<uint16_t>(prev + delta);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// restart block from sequence number start
+void HistoryBlock::reset(uint32_t start) {
+    start_ = start;
+    count_ = 0;
+    bitPos_ = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// append sample to the block
+/// @returns false if the block is full
+bool HistoryBlock::append(const HistorySample& sample) {
+    if (0 == count_) {
+        first_ = sample;
+    } else {
+        const auto bits = bitsFor_(last_.deciWatts, sample.deciWatts) + bitsFor_(last_.deciVolts, sample.deciVolts);
+        if (bitPos_ + bits > BITS_BYTES * 8) return false;
+
+        writeValue_(last_.deciWatts, sample.deciWatts);
+        writeValue_(last_.deciVolts, sample.deciVolts);
+    }
+
+    last_ = sample;
+    ++count_;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// encoded bits needed for a value
+uint32_t HistoryBlock::bitsFor_(uint16_t prev, uint16_t value) {
+    const auto zz = zigZag(prev, value);
+    if (0 == zz) return 1;
+    if (zz <= 8) return 2 + 3;
+    if (zz < 128) return 3 + 7;
+    return 3 + 16;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// append bits (most significant first)
+void HistoryBlock::writeBits_(uint32_t value, uint32_t count) {
+    while (count--) {
+        const auto mask = static_cast<uint8_t>(0x80 >> (bitPos_ & 7));
+        if (value & (uint32_t{1} << count)) {
+            bits_[bitPos_ >> 3] |= mask;
+        } else {
+            bits_[bitPos_ >> 3] &= ~mask;
+        }
+        ++bitPos_;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// append encoded value
+void HistoryBlock::writeValue_(uint16_t prev, uint16_t value) {
+    const auto zz = zigZag(prev, value);
+    if (0 == zz) {
+        writeBits_(0x0, 1);
+    } else if (zz <= 8) {
+        writeBits_(0x2, 2);
+        writeBits_(zz - 1, 3);
+    } else if (zz < 128) {
+        writeBits_(0x6, 3);
+        writeBits_(zz, 7);
+    } else {
+        writeBits_(0x7, 3);
+        writeBits_(zz, 16);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// decode next sample
+/// @returns false at the end of the block
+bool HistoryBlock::Decoder::next(HistorySample& sample) {
+    if (index_ >= block_.count_) return false;
+
+    if (0 == index_) {
+        prev_ = block_.first_;
+    } else {
+        prev_.deciWatts = readValue_(prev_.deciWatts);
+        prev_.deciVolts = readValue_(prev_.deciVolts);
+    }
+
+    ++index_;
+    sample = prev_;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read bits (most significant first)
+uint32_t HistoryBlock::Decoder::readBits_(uint32_t count) {
+    uint32_t value = 0;
+    while (count--) {
+        const auto bit = (block_.bits_[bitPos_ >> 3] >> (7 - (bitPos_ & 7))) & 1;
+        value = (value << 1) | bit;
+        ++bitPos_;
+    }
+    return value;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read encoded value
+uint16_t HistoryBlock::Decoder::readValue_(uint16_t prev) {
+    if (0 == readBits_(1)) return prev;
+    if (0 == readBits_(1)) return unZigZag(prev, static_cast<uint16_t>(readBits_(3) + 1));
+    if (0 == readBits_(1)) return unZigZag(prev, static_cast<uint16_t>(readBits_(7)));
+    return unZigZag(prev, static_cast<uint16_t>(readBits_(16)));
+}
@@ -0,0 +1,86 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Compressed block of measurement history samples
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__HISTORY_BLOCK
+#define INCLUDED__HISTORY_BLOCK
+
+//- includes
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// compact history sample
+struct HistorySample {
+    uint16_t    deciWatts;  ///< power (0.1 W)
+    uint16_t    deciVolts;  ///< voltage (0.1 V)
+};
+
+/////////////////////////////////////////////////////////////////////////////
+/// fixed size block of compressed samples, decodable independently
+///
+/// The first sample is held as is, following samples as the zig-zag
+/// encoded difference from the previous sample, using a variable length
+/// bit code per value:
+///   0                 no change (1 bit)
+///   10  + 3 bits      zig-zag 1..8 (5 bits)
+///   110 + 7 bits      zig-zag 0..127 (10 bits)
+///   111 + 16 bits     zig-zag (19 bits)
+///
+/// Samples are at a fixed interval, so their times are implied by the
+/// block's starting sequence number rather than being stored.
+class HistoryBlock {
+public:
+    enum : uint32_t {
+        SIZE        = 64,   ///< block size (bytes)
+        HEADER_SIZE = 16,   ///< bytes preceding the encoded samples
+        BITS_BYTES  = SIZE - HEADER_SIZE,   ///< bytes available for encoded samples
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    /// sequentially decodes samples from a block
+    class Decoder {
+    public:
+        explicit Decoder(const HistoryBlock& block) : block_(block) { }
+
+        bool next(HistorySample& sample);
+
+    private:
+        uint32_t readBits_(uint32_t count);
+        uint16_t readValue_(uint16_t prev);
+
+        const HistoryBlock& block_;     ///< block being decoded
+        HistorySample       prev_{};    ///< previously decoded sample
+        uint32_t            index_{0};  ///< index of next sample
+        uint32_t            bitPos_{0}; ///< read position
+    };
+
+    void reset(uint32_t start);
+    bool append(const HistorySample& sample);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// sequence number of the first sample
+    uint32_t start() const { return start_; }
+    /// number of samples held
+    uint32_t count() const { return count_; }
+    /// sequence number following the last sample
+    uint32_t end() const { return start_ + count_; }
+
+private:
+    static uint32_t bitsFor_(uint16_t prev, uint16_t value);
+    void writeBits_(uint32_t value, uint32_t count);
+    void writeValue_(uint16_t prev, uint16_t value);
+
+    uint32_t        start_{0};              ///< sequence number of the first sample
+    uint16_t        count_{0};              ///< number of samples
+    HistorySample   first_{};               ///< first sample
+    HistorySample   last_{};                ///< last sample (not part of the encoding)
+    uint16_t        bitPos_{0};             ///< write position
+    uint8_t         bits_[BITS_BYTES]{};    ///< encoded samples
+};
+
+static_assert(sizeof(HistoryBlock) == HistoryBlock::SIZE, "unexpected HistoryBlock size");
+
+#endif // INCLUDED__HISTORY_BLOCK
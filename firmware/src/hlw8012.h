@@ -0,0 +1,90 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+HLW8012 energy metering IC conversions
+
+Conversions are performed in fixed point with all scale factors folded at
+compile time, avoiding soft-float math on the FPU-less ESP8266.
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__HLW8012
+#define INCLUDED__HLW8012
+
+//- includes
+#include <cstdint>
+
+namespace hlw8012 {
+
+// fcf  = v1 * v2 * 48 / v2ref * fosc / 128
+// fcf1 = v1 * 24 / vref * fosc / 512
+
+// https://tech.scargill.net/pow-th16-and-dual/
+// V1 is the differential voltage between measurement pins V1P - V1N (+/-43.75mV peak)
+// V2 is the differential voltage between measurement pins V2P and GND (+/-700mV peak)
+// fosc is 3.579 MHz -+/-15 %)
+// Vref is 2.43 V
+
+constexpr double FOSC = 3579000.0;
+constexpr double VREF = 2.43;
+
+constexpr double V1_R = 0.002;
+constexpr double V2_R1 = 2 * 953000.0;
+constexpr double V2_R2 = 1000.0;
+constexpr double V2_RDIV = V2_R2 / (V2_R1 + V2_R2);
+
+/// Voltage RMS calculation formula
+/// fcfu = (v2 * 2) / vref * fosc / 512
+constexpr double VOLTS_PER_HZ = 512 / FOSC * VREF / 2.0 / V2_RDIV;
+/// fcf = (v1 * v2 * 48) / vref^2 * fosc / 128
+constexpr double WATTS_PER_HZ = 128 / FOSC * (VREF * VREF) / 48.0 / V2_RDIV / V1_R;
+
+/////////////////////////////////////////////////////////////////////////////
+/// round a positive compile time constant to an integer
+constexpr uint64_t roundConstant(double value) {
+    return static_cast<uint64_t>(value + 0.5);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// pulse width (50% duty cycle) => value
+/// value = UNITS_PER_HZ / (2 * pulseWidth) is folded into a single numerator
+constexpr uint64_t MILLIVOLT_MICROS = roundConstant(VOLTS_PER_HZ * 1000 * 1000000 / 2);
+constexpr uint64_t MILLIWATT_MICROS = roundConstant(WATTS_PER_HZ * 1000 * 1000000 / 2);
+static_assert(MILLIVOLT_MICROS <= UINT32_MAX, "MILLIVOLT_MICROS exceeds 32 bits");
+static_assert(MILLIWATT_MICROS <= UINT32_MAX, "MILLIWATT_MICROS exceeds 32 bits");
+
+/// convert CF1 pulse width to mains voltage (mV)
+inline uint32_t milliVoltsFromPulseWidth(uint32_t pulseWidthMicros) {
+    return (pulseWidthMicros) ? static_cast<uint32_t>(MILLIVOLT_MICROS) / pulseWidthMicros : 0;
+}
+/// convert CF pulse width to active power (mW)
+inline uint32_t milliWattsFromPulseWidth(uint32_t pulseWidthMicros) {
+    return (pulseWidthMicros) ? static_cast<uint32_t>(MILLIWATT_MICROS) / pulseWidthMicros : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// frequency => value
+/// value = frequency * UNITS_PER_HZ, scaled by 2^FREQUENCY_SHIFT
+constexpr int FREQUENCY_SHIFT = 24;
+constexpr uint64_t MILLIVOLT_PER_MILLIHZ = roundConstant(VOLTS_PER_HZ * (1ull << FREQUENCY_SHIFT));
+constexpr uint64_t MILLIWATT_PER_MILLIHZ = roundConstant(WATTS_PER_HZ * (1ull << FREQUENCY_SHIFT));
+static_assert(MILLIVOLT_PER_MILLIHZ <= UINT32_MAX, "MILLIVOLT_PER_MILLIHZ exceeds 32 bits");
+static_assert(MILLIWATT_PER_MILLIHZ <= UINT32_MAX, "MILLIWATT_PER_MILLIHZ exceeds 32 bits");
+
+/// convert CF1 frequency to mains voltage (mV)
+inline uint32_t milliVoltsFromFrequency(uint32_t milliHz) {
+    return static_cast<uint32_t>((uint64_t{milliHz} * MILLIVOLT_PER_MILLIHZ) >> FREQUENCY_SHIFT);
+}
+/// convert CF frequency to active power (mW)
+inline uint32_t milliWattsFromFrequency(uint32_t milliHz) {
+    return static_cast<uint32_t>((uint64_t{milliHz} * MILLIWATT_PER_MILLIHZ) >> FREQUENCY_SHIFT);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// CF pulse => energy
+/// each CF pulse is WATTS_PER_HZ joules (power = WATTS_PER_HZ * frequency)
+constexpr uint64_t MICROJOULES_PER_PULSE = roundConstant(WATTS_PER_HZ * 1000000);
+
+} // namespace hlw8012
+
+#endif // INCLUDED__HLW8012
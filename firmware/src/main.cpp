@@ -10,10 +10,13 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 //- includes
 #include "button.h"
 #include "console.h"
+#include "flash_log.h"
 #include "heartbeat.h"
 #include "settings.h"
 #include "smartplug.h"
+#include "spiffs_log_storage.h"
 #include "update_manager.h"
+#include "utils.h"
 #include "version.h"
 #include "web_server.h"
 #include "wifi_manager.h"
@@ -27,6 +30,8 @@ namespace {
     HeartBeat           heartBeat{SmartPlug::PIN_MOD_LED};
     Settings            settings;
     SmartPlug           smartPlug{settings};
+    SpiffsLogStorage    logStorage{"/history.log", 32}; // 128 KB, ~7.5 days of minutes
+    FlashLog            flashLog{logStorage};
     UpdateManager       updateManager;
     WebServer           webServer{settings};
     WifiManager         wifiManager{settings, SmartPlug::PIN_BLUE_LED};
@@ -90,11 +95,22 @@ void cmdReboot(const char*[], int) {
 }
 /// dump state
 void cmdState(const char*[], int) {
-    DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
-    settings.toJson(doc);
-    serializeJson(doc, Serial);
+    settings.printJson(Serial);
     Serial.println();
 }
+/// capture raw pulse trace
+void cmdTrace(const char* argv[], int argc) {
+    if (argc <= 0) {
+        const auto& trace = smartPlug.trace();
+        printf("Trace: %u of %u edges\r\n", unsigned(trace.count()), unsigned(trace.requested()));
+        printf("trace (count 1-%u), download from /api/v1/trace\r\n", unsigned(PulseTrace::CAPACITY));
+        return;
+    }
+
+    if (!smartPlug.startTrace(strtoul(argv[0], nullptr, 10))) {
+        printf("Invalid count, or trace being downloaded\r\n");
+    }
+}
 /// output our version
 void cmdVersion(const char*[], int) {
     printVersion();
@@ -167,10 +183,27 @@ void loadSettings() {
     }
 
     //
-    settings.onPersistProperties([](const JsonDocument& docProps) {
+    settings.onPersistProperties([](PropertyNode& props, int flags) {
         File configFile = SPIFFS.open("/config.json", "w");
-        if (configFile) serializeJson(docProps, configFile);
+        if (configFile) props.printJson(configFile, flags);
+    });
+
+    // energy is persisted separately, on its own schedule
+    File energyFile = SPIFFS.open("/energy.json", "r");
+    if (energyFile) smartPlug.loadEnergy(energyFile);
+
+    smartPlug.onPersistEnergy([](const JsonDocument& docEnergy) {
+        File energyFile = SPIFFS.open("/energy.json", "w");
+        if (energyFile) serializeJson(docEnergy, energyFile);
     });
+
+    // per minute history log
+    if (logStorage.begin()) {
+        flashLog.begin();
+        settings.onSample([](const History::Sample& sample) {
+            flashLog.add(utils::unixTime(), sample);
+        });
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -190,11 +223,17 @@ void setup() {
     printf("Initialize WiFi...\r\n");
     wifiManager.begin();
 
+    // UTC time for energy days
+    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
+
     smartPlug.begin();
 
     printf("Starting OTA...\r\n");
     updateManager.attachUpdating([](bool inProgress) {
-        if (inProgress) smartPlug.setRelay(false);
+        if (inProgress) {
+            smartPlug.setRelay(false);
+            smartPlug.saveEnergy();
+        }
     });
     updateManager.begin(wifiManager.hostname());
 
@@ -202,7 +241,7 @@ void setup() {
 
     //
     printf("Starting web server...\r\n");
-    webServer.begin(wifiManager);
+    webServer.begin(wifiManager, flashLog, smartPlug.trace());
 
     //
     static Console::Command commands[] = {
@@ -213,6 +252,7 @@ void setup() {
         { "help",    &Console::cmdHelp },
         { "reboot",  &cmdReboot },
         { "state",   &cmdState },
+        { "trace",   &cmdTrace },
         { "wifi",    &cmdWifi },
         { "version", &cmdVersion },
     };
@@ -231,7 +271,10 @@ void loop() {
     webServer.tick();
     wifiManager.tick();
 
-    if (settings.needReboot()) ESP.reset();
+    if (settings.needReboot()) {
+        smartPlug.saveEnergy();
+        ESP.reset();
+    }
 
     yield();
 }
@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Overpower protection
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "overpower.h"
+#include "hlw8012.h"
+
+namespace {
+    /// milliwatts * CF period (us)
+    const uint64_t MILLIWATT_PERIOD_MICROS = 2 * hlw8012::MILLIWATT_MICROS;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// configure limit (0 = disabled) and inrush allowance
+/// interrupts should be disabled while configuring
+void Overpower::configure(uint32_t limitMilliWatts, uint32_t inrushMillis, uint32_t ticksPerMicro) {
+    if (inrushMillis > INRUSH_MAX_MILLIS) inrushMillis = INRUSH_MAX_MILLIS;
+    if (0 == ticksPerMicro) ticksPerMicro = 1;
+
+    minPeriod_ = (limitMilliWatts)
+        ? static_cast<uint32_t>(MILLIWATT_PERIOD_MICROS * ticksPerMicro / limitMilliWatts)
+        : 0;
+    inrushTicks_ = inrushMillis * 1000 * ticksPerMicro;
+    glitchTicks_ = GLITCH_MICROS * ticksPerMicro;
+    ticksPerMicro_ = ticksPerMicro;
+
+    started_ = false;
+    over_ = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// power which tripped (mW)
+uint32_t Overpower::tripMilliWatts() const {
+    const uint32_t period = tripPeriod_;
+    return (period) ? static_cast<uint32_t>(MILLIWATT_PERIOD_MICROS * ticksPerMicro_ / period) : 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// rearm after a trip
+/// interrupts should be disabled while clearing
+void Overpower::clear() {
+    tripped_ = false;
+    tripPeriod_ = 0;
+    started_ = false;
+    over_ = 0;
+}
@@ -0,0 +1,84 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Overpower protection
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__OVERPOWER
+#define INCLUDED__OVERPOWER
+
+//- includes
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// detects power above a limit from CF pulse periods
+///
+/// edge() is called from the CF ISR with each falling edge's CPU cycle
+/// count, so the relay can be opened within a couple of CF periods (~2 ms
+/// at 2 kW) rather than waiting on tick(). The power limit is folded into
+/// a minimum period up front, leaving a subtraction and compare per edge.
+///
+/// Power must remain above the limit for TRIP_PERIODS consecutive periods
+/// and the inrush allowance before tripping, tolerating switch-on surges
+/// and a single spurious period. Edges closer than GLITCH_MICROS are ignored.
+class Overpower {
+public:
+    enum : uint32_t {
+        TRIP_PERIODS        = 2,        ///< consecutive periods above limit to trip
+        GLITCH_MICROS       = 10,       ///< ignore edges closer than this
+        INRUSH_MAX_MILLIS   = 10000,    ///< longest inrush allowance (fits 32-bit cycles at 160 MHz)
+    };
+
+    void configure(uint32_t limitMilliWatts, uint32_t inrushMillis, uint32_t ticksPerMicro);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// protection enabled?
+    bool enabled() const { return 0 != minPeriod_; }
+
+    /// power exceeded limit? (until cleared)
+    bool tripped() const { return tripped_; }
+    uint32_t tripMilliWatts() const;
+    void clear();
+
+    /////////////////////////////////////////////////////////////////////////
+    /// process a CF falling edge (called from ISR)
+    /// periods are 32-bit cycle differences, which wrap harmlessly as
+    /// TRIP_PERIODS consecutive short periods are required
+    /// @returns true if power exceeded the limit (trip now)
+    inline __attribute__((always_inline)) bool edge(uint32_t ticks) {
+        const uint32_t period = ticks - last_;
+        if (started_ && period < glitchTicks_) return false;
+
+        const bool started = started_;
+        last_ = ticks;
+        started_ = true;
+        if (!started || 0 == minPeriod_ || tripped_) return false;
+
+        if (period >= minPeriod_) {
+            over_ = 0;
+            return false;
+        }
+        if (0 == over_++) overStart_ = ticks - period;
+        if (over_ < TRIP_PERIODS || (ticks - overStart_) < inrushTicks_) return false;
+
+        tripPeriod_ = period;
+        tripped_ = true;
+        return true;
+    }
+
+private:
+    uint32_t            minPeriod_{0};      ///< periods shorter than this exceed the limit (ticks, 0 = disabled)
+    uint32_t            inrushTicks_{0};    ///< inrush allowance (ticks)
+    uint32_t            glitchTicks_{0};    ///< glitch rejection (ticks)
+    uint32_t            ticksPerMicro_{1};  ///< ticks per microsecond
+
+    uint32_t            last_{0};           ///< last falling edge
+    uint32_t            overStart_{0};      ///< start of first period above limit
+    uint32_t            over_{0};           ///< consecutive periods above limit
+    bool                started_{false};    ///< last_ is valid
+    volatile uint32_t   tripPeriod_{0};     ///< period which tripped (ticks)
+    volatile bool       tripped_{false};    ///< limit exceeded
+};
+
+#endif // INCLUDED__OVERPOWER
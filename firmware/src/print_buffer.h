@@ -0,0 +1,78 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Print destinations for streamed output
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__PRINT_BUFFER
+#define INCLUDED__PRINT_BUFFER
+
+//- includes
+#include <Print.h>
+#include <algorithm>
+#include <cstring>
+
+/////////////////////////////////////////////////////////////////////////////
+/// counts bytes printed (a measuring pass before printing for real)
+class PrintLength : public Print {
+public:
+    /////////////////////////////////////////////////////////////////////////
+    /// bytes printed
+    size_t length() const { return length_; }
+
+    size_t write(uint8_t /*c*/) override {
+        ++length_;
+        return 1;
+    }
+    size_t write(const uint8_t* /*buffer*/, size_t size) override {
+        length_ += size;
+        return size;
+    }
+
+private:
+    size_t  length_{0};     ///< bytes printed
+};
+
+/////////////////////////////////////////////////////////////////////////////
+/// prints into a fixed buffer, dropping anything which doesn't fit
+/// skipping the first bytes gives a window into longer output (e.g. a
+/// chunk of a response, printed afresh for each chunk)
+class PrintBuffer : public Print {
+public:
+    PrintBuffer(uint8_t* buffer, size_t size, size_t skip = 0)
+    : buffer_(buffer)
+    , size_(size)
+    , skip_(skip)
+    { }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// bytes held
+    size_t length() const { return length_; }
+
+    size_t write(uint8_t c) override {
+        if (skip_) {
+            --skip_;
+            return 1;
+        }
+        if (length_ >= size_) return 0;
+        buffer_[length_++] = c;
+        return 1;
+    }
+    size_t write(const uint8_t* buffer, size_t size) override {
+        const auto skipped = std::min(size, skip_);
+        skip_ -= skipped;
+        const auto len = std::min(size - skipped, size_ - length_);
+        memcpy(buffer_ + length_, buffer + skipped, len);
+        length_ += len;
+        return skipped + len;
+    }
+
+private:
+    uint8_t*    buffer_;        ///< destination
+    size_t      size_;          ///< destination size
+    size_t      skip_;          ///< bytes still to skip
+    size_t      length_{0};     ///< bytes held
+};
+
+#endif // INCLUDED__PRINT_BUFFER
@@ -8,6 +8,34 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 
 //- includes
 #include "property.h"
+#include "print_buffer.h"
+
+namespace {
+    /// deepest nesting printed from the change list
+    constexpr size_t DEPTH_MAX = 8;
+
+    /// compare name against key (not NUL terminated)
+    int compareName(const char* name, const char* key, size_t length) {
+        const int res = strncmp(name, key, length);
+        if (0 != res) return res;
+        return ('\0' != name[length]) ? 1 : 0;
+    }
+
+    /// print MessagePack map header
+    size_t printMapHeader(Print& out, uint16_t count) {
+        if (count < 16) return out.write(uint8_t(0x80 | count));   // fixmap
+        size_t len = out.write(uint8_t{0xDE});                      // map 16
+        len += out.write(uint8_t(count >> 8));
+        return len + out.write(uint8_t(count));
+    }
+    /// print MessagePack leaf id key
+    size_t printMapKey(Print& out, uint16_t id) {
+        if (id < 128) return out.write(uint8_t(id));                // positive fixint
+        size_t len = out.write(uint8_t{0xCD});                      // uint 16
+        len += out.write(uint8_t(id >> 8));
+        return len + out.write(uint8_t(id));
+    }
+}
 
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
@@ -15,30 +43,134 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 /////////////////////////////////////////////////////////////////////////////
 /////////////////////////////////////////////////////////////////////////////
 
+uint32_t Property::generation_ = 0;
+uint32_t Property::layout_ = 0;
+std::vector<Property::Observer> Property::observers_;
+
 /////////////////////////////////////////////////////////////////////////////
 /// constructor
-Property::Property(PropertyNode* parent, String name, int flags)
-: name_(std::move(name))
+/// name isn't copied, it must outlive the property (typically a string literal)
+Property::Property(PropertyNode* parent, const char* name, int flags)
+: name_(name)
 , flags_(flags)
 {
     if (parent) parent->addChild(*this);
-    for (auto it = this; it; it = it->parent_) it->flags_ |= (DIRTY | flags);
+
+    // parents are changed, and persisted if we are
+    const int inherited = flags & PERSIST;
+    const auto changed = ++generation_;
+    for (auto it = this; it; it = it->parent_) {
+        it->flags_ |= inherited;
+        it->changed_ = changed;
+    }
+    linkChange_();
 }
 /// destructor
 Property::~Property() {
+    unlinkChange_(); // while our root can still be found
     if (parent_) parent_->removeChild(*this);
     parent_ = nullptr;
+
+    if (flags_ & OBSERVED) {
+        observers_.erase(std::remove_if(observers_.begin(), observers_.end(), [this](const Observer& observer) {
+            return this == observer.prop;
+        }), observers_.end());
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////
-/// clear dirty
+/// clear persist dirty
 void Property::clearDirty() {
-    flags_ &= ~(DIRTY | DIRTY_PERSIST);
+    flags_ &= ~DIRTY_PERSIST;
 }
-/// mark property (+ parents) as dirty
+/// mark property (+ parents) as changed in a new generation (+ persist dirty)
 void Property::setDirty() {
-    const int flags = DIRTY | (persist() ? DIRTY_PERSIST : 0);
-    for (auto it = this; it; it = it->parent_) it->flags_ |= flags;
+    const int flags = persist() ? DIRTY_PERSIST : 0;
+    const auto changed = ++generation_;
+    for (auto it = this; it; it = it->parent_) {
+        it->flags_ |= flags;
+        it->changed_ = changed;
+    }
+
+    // most recently changed
+    if (!asNode()) {
+        unlinkChange_();
+        linkChange_();
+    }
+
+    // once consistent, tell observers (of us + parents)
+    for (auto it = this; it; it = it->parent_) {
+        if (it->flags_ & OBSERVED) it->notify_(*this);
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// observe changes to this property (or any beneath it)
+/// synchronous observers are called from within set(), deferred observers
+/// from the next notifyDeferred() (once however many changes there were)
+void Property::observe(FuncObserver func, bool deferred) {
+    flags_ |= OBSERVED;
+    observers_.push_back({ this, std::move(func), deferred, false });
+}
+/// call deferred observers with changes since the last call (once per loop turn)
+void Property::notifyDeferred() {
+    for (size_t i = 0; i < observers_.size(); ++i) {
+        if (!observers_[i].pending) continue;
+        observers_[i].pending = false;
+
+        // copied, the callback may register observers
+        const auto func = observers_[i].func;
+        func(*observers_[i].prop);
+    }
+}
+/// notify our observers of a change
+void Property::notify_(Property& changed) {
+    for (size_t i = 0; i < observers_.size(); ++i) {
+        if (this != observers_[i].prop) continue;
+        if (observers_[i].deferred) {
+            observers_[i].pending = true;
+        } else {
+            const auto func = observers_[i].func;
+            func(changed);
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// root of the tree we're in
+/// @returns nullptr if we have no parent
+PropertyNode* Property::root_() const {
+    auto root = parent_;
+    while (root && root->parent_) root = root->parent_;
+    return root;
+}
+/// append to our root's change list
+/// leaves are kept in order of change (generation), a list per tree, so
+/// the changes since a generation are found walking back from the last
+void Property::linkChange_() {
+    const auto root = root_();
+    if (!root) return;
+    if (!root->changes_) root->changes_.reset(new PropertyNode::Changes);
+    auto& changes = *root->changes_;
+
+    changePrev_ = changes.last;
+    changeNext_ = nullptr;
+    if (changes.last) changes.last->changeNext_ = this;
+    else changes.first = this;
+    changes.last = this;
+}
+/// remove from our root's change list (if present)
+void Property::unlinkChange_() {
+    const auto root = root_();
+    if (!root || !root->changes_) return;
+    auto& changes = *root->changes_;
+
+    if (changePrev_) changePrev_->changeNext_ = changeNext_;
+    else if (changes.first == this) changes.first = changeNext_;
+    if (changeNext_) changeNext_->changePrev_ = changePrev_;
+    else if (changes.last == this) changes.last = changePrev_;
+    changePrev_ = nullptr;
+    changeNext_ = nullptr;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -61,6 +193,8 @@ void PropertyNode::addChild(Property& child) {
     assert(!child.siblingPrev_ && !child.siblingNext_);
 
     child.parent_ = this;
+    index_.clear();
+    ++layout_;
 
     child.siblingNext_ = nullptr;
     child.siblingPrev_ = childLast_;
@@ -81,10 +215,48 @@ void PropertyNode::removeChild(Property& child) {
     if (&child == childLast_)  childLast_  = child.siblingPrev_;
 
     child.parent_ = nullptr;
+    index_.clear();
+    ++layout_;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// child property by name
+/// the first lookup indexes our children, so nodes never searched don't pay for it
+/// @returns nullptr if not found
+Property* PropertyNode::child(const char* name, size_t length) {
+    if (index_.empty()) {
+        for (auto it = childFirst_; it; it = it->siblingNext_) index_.push_back(it);
+        std::stable_sort(index_.begin(), index_.end(), [](const Property* a, const Property* b) {
+            return strcmp(a->name(), b->name()) < 0;
+        });
+    }
+
+    const auto it = std::lower_bound(index_.begin(), index_.end(), name, [length](const Property* prop, const char* key) {
+        return compareName(prop->name(), key, length) < 0;
+    });
+    return (it != index_.end() && 0 == compareName((*it)->name(), name, length)) ? *it : nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// descendant property by dotted path (e.g. "sys.net.cur.ipv4Address")
+/// @returns nullptr if not found
+Property* PropertyNode::find(const char* path) {
+    auto node = this;
+    for (;;) {
+        const char* dot = strchr(path, '.');
+        const size_t length = dot ? size_t(dot - path) : strlen(path);
+
+        auto prop = node->child(path, length);
+        if (!prop || !dot) return prop;
+
+        node = prop->asNode();
+        if (!node) return nullptr;
+        path = dot + 1;
+    }
 }
 
 /////////////////////////////////////////////////////////////////////////////
-/// clear dirty
+/// clear persist dirty
 void PropertyNode::clearDirty() {
     Property::clearDirty();
     for (auto it = childFirst_; it; it = it->siblingNext_) {
@@ -99,10 +271,12 @@ void PropertyNode::fromJson(const JsonVariant& json) {
 }
 /// load data from JSON
 void PropertyNode::fromJson_(const JsonVariant& json) {
-    if (json.isNull()) return;
-    for (auto child = childFirst_; child; child = child->siblingNext_) {
-        if (child->persist()) {
-            child->fromJson_( json[child->name()] );
+    if (!json.is<JsonObject>()) return;
+    for (const auto member : json.as<JsonObject>()) {
+        const char* key = member.key().c_str();
+        auto prop = child(key, strlen(key));
+        if (prop && prop->persist()) {
+            prop->fromJson_( member.value() );
         }
     }
 }
@@ -111,8 +285,7 @@ void PropertyNode::fromJson_(const JsonVariant& json) {
 /// visit our property nodes
 void PropertyNode::toJson(JsonDocument& json, int flags) {
     auto obj = json.to<JsonObject>();
-    if ((flags & DIRTY)   && (flags_ & DIRTY)) flags_ &= ~DIRTY;
-    if ((flags & PERSIST) && (flags_ & DIRTY_PERSIST)) flags_ &= ~DIRTY_PERSIST;
+    if (flags & PERSIST) flags_ &= ~DIRTY_PERSIST;
     jsonChildren_(obj, flags);
 }
 /// convert child properties to JSON
@@ -123,12 +296,6 @@ void PropertyNode::toJson_(JsonObject& json, int flags) {
 /// populate JSON with children
 void PropertyNode::jsonChildren_(JsonObject& json, int flags) {
     for (auto child = childFirst_; child; child = child->siblingNext_) {
-        // filter + clear dirty
-        if (flags & DIRTY) {
-            if (!child->dirty()) continue; // skip non-dirty nodes
-            child->flags_ &= ~DIRTY;
-        }
-
         // filter persistent properties
         if (flags & PERSIST) {
             if (!child->persist()) continue; // skip non-persistent nodes
@@ -139,3 +306,189 @@ void PropertyNode::jsonChildren_(JsonObject& json, int flags) {
         child->toJson_(json, flags);
     }
 }
+
+/////////////////////////////////////////////////////////////////////////////
+/// print JSON straight to out, without building a document
+/// flags filter properties (clearing persist dirty) as per toJson
+/// since filters properties to those changed after that generation, from
+/// a root without flags that's only the changed leaves (not the whole tree)
+/// @returns bytes printed
+size_t PropertyNode::printJson(Print& out, int flags, uint32_t since, bool clear) {
+    if (changesOnly_(flags, since)) return printJsonChanges_(out, since);
+    if (clear && (flags & PERSIST)) flags_ &= ~DIRTY_PERSIST;
+    return printJson_(out, flags, since, clear);
+}
+/// bytes printJson would print (leaving flags untouched)
+size_t PropertyNode::measureJson(int flags, uint32_t since) {
+    PrintLength length;
+    printJson(length, flags, since, false);
+    return length.length();
+}
+/// print child properties as a JSON object
+size_t PropertyNode::printJson_(Print& out, int flags, uint32_t since, bool clear) {
+    size_t len = out.write('{');
+    bool first = true;
+    for (auto child = childFirst_; child; child = child->siblingNext_) {
+        // filter by generation
+        if (child->changed_ <= since) continue;
+
+        // filter persistent properties
+        if (flags & PERSIST) {
+            if (!child->persist()) continue; // skip non-persistent nodes
+            if (clear) child->flags_ &= ~DIRTY_PERSIST;
+        }
+
+        if (!first) len += out.write(',');
+        first = false;
+        len += serializeValue_(out, child->name());
+        len += out.write(':');
+        len += child->printJson_(out, flags, since, clear);
+    }
+    return len + out.write('}');
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// print MessagePack straight to out
+/// a flat map of leaf id (see toJsonSchema) to value, for the leaves
+/// printJson would include given flags and since (clearing flags likewise)
+/// @returns bytes printed
+size_t PropertyNode::printMsgPack(Print& out, int flags, uint32_t since, bool clear) {
+    if (changesOnly_(flags, since)) return printMsgPackChanges_(out, since);
+
+    uint16_t count = 0;
+    uint16_t id = 0;
+    visitLeaves_(flags, since, false, true, id, [&count](uint16_t, Property&) { ++count; });
+
+    size_t len = printMapHeader(out, count);
+
+    if (clear && (flags & PERSIST)) flags_ &= ~DIRTY_PERSIST;
+
+    id = 0;
+    visitLeaves_(flags, since, clear, true, id, [&out, &len](uint16_t id, Property& leaf) {
+        len += printMapKey(out, id);
+        len += leaf.printValue_(out, true);
+    });
+    return len;
+}
+/// bytes printMsgPack would print (leaving flags untouched)
+size_t PropertyNode::measureMsgPack(int flags, uint32_t since) {
+    PrintLength length;
+    printMsgPack(length, flags, since, false);
+    return length.length();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// our leaves changed since a generation, in id order
+/// walks back through our change list, so costs the changes rather than the tree,
+/// and is kept until the tree changes (measuring then printing collects once)
+const std::vector<Property*>& PropertyNode::changedLeaves_(uint32_t since) {
+    if (!changes_) changes_.reset(new Changes);
+    auto& changes = *changes_;
+    if (changes.since == since && changes.changed == changed_ && changes.layout == layout_) return changes.leaves;
+
+    numberLeaves_();
+    changes.since = since;
+    changes.changed = changed_;
+    changes.layout = layout_;
+    changes.leaves.clear();
+    for (auto it = changes.last; it && it->changed_ > since; it = it->changePrev_) changes.leaves.push_back(it);
+    std::sort(changes.leaves.begin(), changes.leaves.end(), [](const Property* a, const Property* b) {
+        return a->leafId_ < b->leafId_;
+    });
+    return changes.leaves;
+}
+/// number our leaves depth first (if children were added/removed since last time)
+void PropertyNode::numberLeaves_() {
+    if (numbered_ == layout_) return;
+    numbered_ = layout_;
+    uint16_t id = 0;
+    visitLeaves_(0, 0, false, true, id, [](uint16_t id, Property& leaf) { leaf.leafId_ = id; });
+}
+/// print changed leaves as JSON, nested within their (open) parents as printJson_
+size_t PropertyNode::printJsonChanges_(Print& out, uint32_t since) {
+    PropertyNode* open[DEPTH_MAX];              // objects open beneath us
+    size_t opened = 0;
+    PropertyNode* path[DEPTH_MAX];              // leaf's parents beneath us
+    size_t len = out.write('{');
+    bool first = true;
+    for (auto leaf : changedLeaves_(since)) {
+        size_t depth = 0;
+        for (auto node = leaf->parent_; node != this; node = node->parent_) ++depth;
+        assert(depth <= DEPTH_MAX && "printJsonChanges_ but tree nested too deeply");
+        auto node = leaf->parent_;
+        for (size_t i = depth; i > 0; --i, node = node->parent_) path[i - 1] = node;
+
+        // close objects the previous leaf doesn't share, open ours
+        size_t shared = 0;
+        while (shared < opened && shared < depth && open[shared] == path[shared]) ++shared;
+        for (; opened > shared; --opened) {
+            len += out.write('}');
+            first = false;
+        }
+        for (; opened < depth; ++opened) {
+            if (!first) len += out.write(',');
+            first = true;
+            open[opened] = path[opened];
+            len += serializeValue_(out, open[opened]->name());
+            len += out.write(':');
+            len += out.write('{');
+        }
+
+        if (!first) len += out.write(',');
+        first = false;
+        len += serializeValue_(out, leaf->name());
+        len += out.write(':');
+        len += leaf->printJson_(out, 0, since, false);
+    }
+    for (; opened > 0; --opened) len += out.write('}');
+    return len + out.write('}');
+}
+/// print changed leaves as MessagePack
+size_t PropertyNode::printMsgPackChanges_(Print& out, uint32_t since) {
+    const auto& leaves = changedLeaves_(since);
+    size_t len = printMapHeader(out, leaves.size());
+    for (auto leaf : leaves) {
+        len += printMapKey(out, leaf->leafId_);
+        len += leaf->printValue_(out, true);
+    }
+    return len;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// visit leaves in id order (depth first), calling func for those included by flags and since
+/// every leaf is counted, so ids don't depend on the filter
+void PropertyNode::visitLeaves_(int flags, uint32_t since, bool clear, bool include, uint16_t& id, const FuncLeaf& func) {
+    for (auto child = childFirst_; child; child = child->siblingNext_) {
+        bool inc = include && child->changed_ > since;
+        if (inc && (flags & PERSIST)) {
+            inc = child->persist();
+            if (inc && clear) child->flags_ &= ~DIRTY_PERSIST;
+        }
+
+        if (auto node = child->asNode()) {
+            node->visitLeaves_(flags, since, clear, inc, id, func);
+        } else {
+            if (inc) func(id, *child);
+            ++id;
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// output the tree with each leaf's MessagePack id in place of its value
+void PropertyNode::toJsonSchema(JsonDocument& json) {
+    auto obj = json.to<JsonObject>();
+    uint16_t id = 0;
+    schemaJson_(obj, id);
+}
+/// populate schema with children
+void PropertyNode::schemaJson_(JsonObject& json, uint16_t& id) {
+    for (auto child = childFirst_; child; child = child->siblingNext_) {
+        if (auto node = child->asNode()) {
+            auto obj = json.createNestedObject(child->name());
+            node->schemaJson_(obj, id);
+        } else {
+            json[child->name()] = id++;
+        }
+    }
+}
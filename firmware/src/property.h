@@ -9,9 +9,16 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 #define INCLUDED__PROPERTY
 
 //- includes
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <IPAddress.h>
+#include <Print.h>
+#include <cstring>
+#include <functional>
+#include <memory>
 #include <utility>
+#include <vector>
 #include <WString.h>
 #include <ArduinoJson.h>
 
@@ -26,6 +33,7 @@ using PropertyFloat     = PropertyValueT<float>;    ///< holds a float
 using PropertyInt       = PropertyValueT<int>;      ///< holds an integer
 using PropertyIpAddress = PropertyValueT<IPAddress>;///< holds an IP address
 using PropertyString    = PropertyValueT<String>;   ///< holds a string
+using PropertyUInt      = PropertyValueT<unsigned>; ///< holds an unsigned integer
 
 /////////////////////////////////////////////////////////////////////////////
 /// property encapsulation
@@ -41,44 +49,118 @@ public:
     Property& operator=(const Property&) = delete;
 
     // property flags
+    // (changes are tracked by generation, see changed(), other than for persistence)
     enum Flags {
-        DIRTY           = 1 << 0,   ///< this property or a child property has been modified
-        DIRTY_PERSIST   = 1 << 1,   ///< this property or a child persisted property has been modified
-        PERSIST         = 1 << 2,   ///< persist this property
+        DIRTY_PERSIST   = 1 << 0,   ///< this property or a child persisted property has been modified (cleared as printed with PERSIST)
+        PERSIST         = 1 << 1,   ///< persist this property
+        WRITABLE        = 1 << 2,   ///< may be assigned remotely (JSON-RPC set)
+        OBSERVED        = 1 << 3,   ///< has change observers (see observe)
     };
 
+    /// change observer
+    /// synchronous observers are passed the changed property, deferred
+    /// observers the observed one (several changes coalesced into one call)
+    using FuncObserver = std::function<void (Property& prop)>;
+
     /////////////////////////////////////////////////////////////////////////
     /// retrieve name
-    const String& name() const { return name_; }
+    const char* name() const { return name_; }
+    /// retrieve parent
+    PropertyNode* parent() const { return parent_; }
+    /// property containing other properties?
+    virtual PropertyNode* asNode() { return nullptr; }
 
     /////////////////////////////////////////////////////////////////////////
-    /// dirty property? (property changed)
-    bool dirty() const { return flags_ & DIRTY; }
+    /// mark changed (+ persist dirty)
     void setDirty();
     virtual void clearDirty();
 
     /// one or more persistent properties dirty?
     bool persistDirty() const { return flags_ & DIRTY_PERSIST; }
 
+    /////////////////////////////////////////////////////////////////////////
+    /// generation of the last change (for nodes, the latest change beneath)
+    /// consumers keep their own cursor and print changes since it, so
+    /// several can follow the tree without taking changes from each other
+    uint32_t changed() const { return changed_; }
+    /// latest generation (a consumer's cursor once it has taken every change)
+    static uint32_t generation() { return generation_; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// observe changes to this property (or any beneath it)
+    void observe(FuncObserver func, bool deferred = false);
+    static void notifyDeferred();
+
     /////////////////////////////////////////////////////////////////////////
     /// persist property?
     bool persist() const { return flags_ & PERSIST; }
     void setPersist();
 
+    /// may be assigned remotely?
+    bool writable() const { return flags_ & WRITABLE; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// output JSON as a member of json
+    void toJson(JsonObject& json) { toJson_(json, 0); }
+
+    /// assign value from JSON (marking changed if it differs)
+    /// @returns false if json doesn't hold a value of our type
+    bool assign(const JsonVariant& json) { return assign_(json); }
+
 protected:
     /////////////////////////////////////////////////////////////////////////
     /// constructor
-    explicit Property(PropertyNode* parent, String name, int flags = 0);
+    explicit Property(PropertyNode* parent, const char* name, int flags = 0);
 
     /////////////////////////////////////////////////////////////////////////
     /// load from JSON
     virtual void fromJson_(const JsonVariant& json) = 0;
     /// convert to JSON
     virtual void toJson_(JsonObject& json, int flags) = 0;
+    /// print JSON value straight to out (clearing persist dirty as printed)
+    virtual size_t printJson_(Print& out, int /*flags*/, uint32_t /*since*/, bool /*clear*/) { return printValue_(out, false); }
+    /// print value as JSON or MessagePack
+    virtual size_t printValue_(Print& out, bool msgPack) {
+        return msgPack ? out.write(uint8_t{0xC0}) : out.print("null");
+    }
+    /// assign from JSON
+    virtual bool assign_(const JsonVariant& /*json*/) { return false; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// print a scalar (or const char*) as JSON or MessagePack
+    /// neither is copied into the document's pool, so it can be tiny
+    template <typename V>
+    static size_t serializeValue_(Print& out, const V& value, bool msgPack = false) {
+        StaticJsonDocument<16> doc;
+        doc.set(value);
+        return msgPack ? serializeMsgPack(doc, out) : serializeJson(doc, out);
+    }
 
 private:
-    const String    name_;                      ///< property name
+    /// registered change observer
+    struct Observer {
+        Property*       prop;       ///< observed property
+        FuncObserver    func;       ///< callback
+        bool            deferred;   ///< called from notifyDeferred
+        bool            pending;    ///< deferred call due
+    };
+
+    void notify_(Property& changed);
+    PropertyNode* root_() const;
+    void linkChange_();
+    void unlinkChange_();
+
+    const char* const name_;                    ///< property name (static, emitted to JSON without copying)
     int             flags_ = 0;                 ///< associated flags
+    uint32_t        changed_ = 0;               ///< generation of the last change
+    uint16_t        leafId_ = 0;                ///< depth first leaf index within our root (see PropertyNode::numberLeaves_)
+
+    Property*       changePrev_ = nullptr;      ///< previously changed leaf (within our root)
+    Property*       changeNext_ = nullptr;      ///< next changed leaf (within our root)
+
+    static uint32_t generation_;                ///< latest generation (counts changes to any property)
+    static uint32_t layout_;                    ///< counts children added/removed (renumbering leaves)
+    static std::vector<Observer> observers_;    ///< change observers (few, so held apart from properties)
 
     PropertyNode*   parent_ = nullptr;          ///< our parent property
     Property*       siblingPrev_ = nullptr;     ///< previous sibling
@@ -91,12 +173,14 @@ private:
 /// splits concept of a property which holds a value (PropertyValueT)
 /// and a property which contains other properties (PropertyNode)
 class PropertyNode : public Property {
+    /// ick; leaves link themselves onto their root's change list
+    friend Property;
 public:
     /////////////////////////////////////////////////////////////////////////
     /// constructor
-    explicit PropertyNode(PropertyNode* parent = nullptr, String name = String{})
-    : Property(parent, std::move(name))
-    { }
+    explicit PropertyNode(PropertyNode* parent = nullptr, const char* name = "")
+    : Property(parent, name)
+    { unlinkChange_(); } // only leaves are tracked by change
     /// destructor
     ~PropertyNode() override = default;
 
@@ -108,18 +192,60 @@ public:
     void addChild(Property& child);
     void removeChild(Property& child);
 
+    PropertyNode* asNode() override { return this; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// child property by name
+    Property* child(const char* name) { return child(name, strlen(name)); }
+    Property* child(const char* name, size_t length);
+    Property* find(const char* path);
+
     void clearDirty() override;
 
     void fromJson(const JsonVariant& json);
+    using Property::toJson;
     void toJson(JsonDocument& json, int flags = 0);
 
+    size_t printJson(Print& out, int flags = 0, uint32_t since = 0, bool clear = true);
+    size_t measureJson(int flags = 0, uint32_t since = 0);
+
+    size_t printMsgPack(Print& out, int flags = 0, uint32_t since = 0, bool clear = true);
+    size_t measureMsgPack(int flags = 0, uint32_t since = 0);
+    void toJsonSchema(JsonDocument& json);
+
 private:
     void fromJson_(const JsonVariant& json) override;
     void toJson_(JsonObject& json, int flags) override;
     void jsonChildren_(JsonObject& json, int flags);
+    size_t printJson_(Print& out, int flags, uint32_t since, bool clear) override;
+
+    bool changesOnly_(int flags, uint32_t since) const { return !parent() && 0 == flags && since > 0; }
+    const std::vector<Property*>& changedLeaves_(uint32_t since);
+    void numberLeaves_();
+    size_t printJsonChanges_(Print& out, uint32_t since);
+    size_t printMsgPackChanges_(Print& out, uint32_t since);
+
+    /// called with each included leaf and its id
+    using FuncLeaf = std::function<void (uint16_t id, Property& leaf)>;
+    void visitLeaves_(int flags, uint32_t since, bool clear, bool include, uint16_t& id, const FuncLeaf& func);
+    void schemaJson_(JsonObject& json, uint16_t& id);
 
     Property*   childFirst_ = nullptr;      ///< first child property
     Property*   childLast_ = nullptr;       ///< last child property
+
+    std::vector<Property*>  index_;         ///< children sorted by name (built on first lookup)
+    uint32_t    numbered_ = 0;              ///< layout our leaves were numbered for (roots only)
+
+    /// a root's changed leaves
+    struct Changes {
+        Property*   first = nullptr;                ///< least recently changed leaf
+        Property*   last = nullptr;                 ///< most recently changed leaf
+        std::vector<Property*> leaves;              ///< collected by changedLeaves_, in id order
+        uint32_t    since = 0;                      ///< generation leaves were collected since (0 none)
+        uint32_t    changed = 0;                    ///< our changed() when collected
+        uint32_t    layout = 0;                     ///< layout when collected
+    };
+    std::unique_ptr<Changes> changes_;      ///< allocated on the first leaf linked (roots only)
 };
 
 
@@ -129,8 +255,8 @@ class PropertyZombie : public Property {
 public:
     /////////////////////////////////////////////////////////////////////////
     /// constructor
-    PropertyZombie(PropertyNode* parent, String name)
-    : Property(parent, std::move(name))
+    PropertyZombie(PropertyNode* parent, const char* name)
+    : Property(parent, name)
     { }
     /// destructor
     ~PropertyZombie() override = default;
@@ -151,8 +277,8 @@ class PropertyValueT : public Property {
 public:
     /////////////////////////////////////////////////////////////////////////
     /// constructor
-    PropertyValueT(PropertyNode* parent, String name, T value = T{}, int flags = 0)
-    : Property(parent, std::move(name), flags)
+    PropertyValueT(PropertyNode* parent, const char* name, T value = T{}, int flags = 0)
+    : Property(parent, name, flags)
     , value_(std::move(value))
     { }
     /// destructor
@@ -174,6 +300,14 @@ public:
     }
 
 protected:
+    /////////////////////////////////////////////////////////////////////////
+    /// assign from JSON
+    bool assign_(const JsonVariant& json) override {
+        if (!json.is<T>()) return false;
+        set(json.as<T>());
+        return true;
+    }
+
     /////////////////////////////////////////////////////////////////////////
     /// process from JSON
     void fromJson_(const JsonVariant& json) override {
@@ -183,6 +317,10 @@ protected:
     void toJson_(JsonObject& json, int /*flags*/) override {
         json[name()] = value();
     }
+    /// print value
+    size_t printValue_(Print& out, bool msgPack) override {
+        return serializeValue_(out, value(), msgPack);
+    }
 
 private:
     T   value_{};   ///< held value
@@ -205,6 +343,23 @@ inline void PropertyValueT<String>::fromJson_(const JsonVariant& json) {
     }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// specialize assignment of IPAddress
+template <>
+inline bool PropertyValueT<IPAddress>::assign_(const JsonVariant& json) {
+    IPAddress address;
+    if (!json.is<const char*>() || !address.fromString(json.as<const char*>())) return false;
+    set(address);
+    return true;
+}
+/// specialize assignment of String
+template <>
+inline bool PropertyValueT<String>::assign_(const JsonVariant& json) {
+    if (!json.is<const char*>()) return false;
+    set(json.as<String>());
+    return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// specialize toJson handling of IPAddress
 template <>
@@ -212,4 +367,70 @@ inline void PropertyValueT<IPAddress>::toJson_(JsonObject& json, int /*flags*/)
     json[name()] = value().isSet() ? value().toString() : String{};
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// specialize printing of IPAddress
+template <>
+inline size_t PropertyValueT<IPAddress>::printValue_(Print& out, bool msgPack) {
+    const auto str = value().isSet() ? value().toString() : String{};
+    return serializeValue_(out, str.c_str(), msgPack);
+}
+/// specialize printing of String (linked rather than copied)
+template <>
+inline size_t PropertyValueT<String>::printValue_(Print& out, bool msgPack) {
+    return serializeValue_(out, value().c_str(), msgPack);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+/// float property which ignores insignificant changes
+///
+/// Values are rounded to a multiple of quantum, then only taken on when
+/// they differ from the held value by more than the deadband, being the
+/// larger of absolute and relative * |held value|. Comparing against the
+/// held (last taken) value rather than the previous reading means slow
+/// drifts are still taken on once they accumulate. Changes to or from zero
+/// (e.g. a load switching off or on) are always taken on.
+class PropertyFloatDeadband : public PropertyValueT<float> {
+public:
+    /// insignificant changes
+    struct Deadband {
+        float   absolute;   ///< absolute deadband
+        float   relative;   ///< deadband relative to the held value (e.g. 0.01 = 1%)
+        float   quantum;    ///< values are rounded to multiples of this (0 = no rounding)
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    /// constructor
+    PropertyFloatDeadband(PropertyNode* parent, const char* name, float value, Deadband deadband, int flags = 0)
+    : PropertyValueT<float>(parent, name, value, flags)
+    , deadband_(deadband)
+    { }
+    /// destructor
+    ~PropertyFloatDeadband() override = default;
+
+    /////////////////////////////////////////////////////////////////////////
+    /// deadband
+    const Deadband& deadband() const { return deadband_; }
+    void setDeadband(const Deadband& deadband) { deadband_ = deadband; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// assign new value, if significant
+    /// @returns true if the value was taken on
+    bool set(float new_value) {
+        if (deadband_.quantum > 0) {
+            new_value = std::round(new_value / deadband_.quantum) * deadband_.quantum;
+        }
+
+        if (new_value == value()) return false;
+        const auto band = std::max(deadband_.absolute, deadband_.relative * std::fabs(value()));
+        if (0 != new_value && 0 != value() && std::fabs(new_value - value()) <= band) return false;
+
+        PropertyValueT<float>::set(new_value);
+        return true;
+    }
+
+private:
+    Deadband    deadband_;  ///< insignificant changes
+};
+
 #endif // INCLUDED__PROPERTY
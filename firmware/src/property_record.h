@@ -0,0 +1,223 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Property record, a fixed set of fields held as one property
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__PROPERTY_RECORD
+#define INCLUDED__PROPERTY_RECORD
+
+//- includes
+#include "property.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/////////////////////////////////////////////////////////////////////////////
+/// field of a record schema (see PROPERTY_FIELD)
+struct PropertyField {
+    /// value types
+    enum Type : uint8_t {
+        BOOL,       ///< bool
+        FLOAT,      ///< float
+        INT,        ///< int
+        UINT,       ///< unsigned
+    };
+
+    const char* name;       ///< field name (static)
+    Type        type;       ///< value type
+    uint8_t     offset;     ///< offset within the schema's Values
+    uint8_t     flags;      ///< Property::PERSIST
+};
+
+/// field type of a member (unsupported types don't compile)
+constexpr PropertyField::Type propertyFieldType(const bool*)     { return PropertyField::BOOL; }
+constexpr PropertyField::Type propertyFieldType(const float*)    { return PropertyField::FLOAT; }
+constexpr PropertyField::Type propertyFieldType(const int*)      { return PropertyField::INT; }
+constexpr PropertyField::Type propertyFieldType(const unsigned*) { return PropertyField::UINT; }
+
+/// describe a member of Values, e.g. PROPERTY_FIELD(Values, mean, 0)
+#define PROPERTY_FIELD(Values, member, flags) \
+    PropertyField{ #member, propertyFieldType(static_cast<decltype(Values::member)*>(nullptr)), offsetof(Values, member), flags }
+
+
+/////////////////////////////////////////////////////////////////////////////
+/// fixed set of fields held as one property
+///
+/// A PropertyNode of PropertyValueT children costs a full property (links,
+/// name, flags, generation, vtable) per field. A record holds its values
+/// packed in Schema::Values, described by a constexpr Schema::FIELDS table
+/// shared by every record of that schema, and serializes them from the
+/// table with a single virtual call. e.g.
+///
+///     struct Schema {
+///         struct Values { float min; float max; };
+///         static constexpr PropertyField FIELDS[] = {
+///             PROPERTY_FIELD(Values, min, 0),
+///             PROPERTY_FIELD(Values, max, 0),
+///         };
+///     };
+///     constexpr PropertyField Schema::FIELDS[]; // definition (in a .cpp)
+///
+/// It's output as an object of its fields, filtered by PERSIST (per field
+/// flags). It changes as a whole, so has one generation, and one
+/// MessagePack id whose value is a map of its fields. Fields aren't found
+/// by path, nor assigned remotely.
+template <typename Schema>
+class PropertyRecordT : public Property {
+public:
+    using Values = typename Schema::Values;
+
+    enum : size_t {
+        FIELDS = sizeof(Schema::FIELDS) / sizeof(Schema::FIELDS[0]),  ///< number of fields
+    };
+    static_assert(FIELDS <= 255, "field count is 8 bit");
+    static_assert(sizeof(Values) <= 256, "field offsets are 8 bit");
+
+    /////////////////////////////////////////////////////////////////////////
+    /// constructor
+    PropertyRecordT(PropertyNode* parent, const char* name, const Values& values = Values{})
+    : Property(parent, name)
+    , values_(values)
+    {
+        for (const auto& field : Schema::FIELDS) {
+            if (field.flags & PERSIST) setPersist();
+        }
+    }
+    /// destructor
+    ~PropertyRecordT() override = default;
+
+    /////////////////////////////////////////////////////////////////////////
+    /// retrieve values
+    const Values& values() const { return values_; }
+
+    /// dereference to values
+    const Values* operator->() const { return &values_; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// assign new values, marking changed if any field differs
+    void set(const Values& values) {
+        for (const auto& field : Schema::FIELDS) {
+            if (!equal_(field, values_, values)) {
+                values_ = values;
+                setDirty();
+                return;
+            }
+        }
+    }
+
+protected:
+    /////////////////////////////////////////////////////////////////////////
+    /// load persisted fields from JSON
+    void fromJson_(const JsonVariant& json) override {
+        for (const auto& field : Schema::FIELDS) {
+            const auto value = json[field.name];
+            if (!(field.flags & PERSIST) || value.isNull()) continue;
+
+            switch (field.type) {
+            case PropertyField::BOOL:   put_(values_, field, value.as<bool>()); break;
+            case PropertyField::FLOAT:  put_(values_, field, value.as<float>()); break;
+            case PropertyField::INT:    put_(values_, field, value.as<int>()); break;
+            case PropertyField::UINT:   put_(values_, field, value.as<unsigned>()); break;
+            }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// output JSON
+    void toJson_(JsonObject& json, int flags) override {
+        auto obj = json.createNestedObject(name());
+        for (const auto& field : Schema::FIELDS) {
+            if (!included_(field, flags)) continue;
+
+            switch (field.type) {
+            case PropertyField::BOOL:   obj[field.name] = get_<bool>(values_, field); break;
+            case PropertyField::FLOAT:  obj[field.name] = get_<float>(values_, field); break;
+            case PropertyField::INT:    obj[field.name] = get_<int>(values_, field); break;
+            case PropertyField::UINT:   obj[field.name] = get_<unsigned>(values_, field); break;
+            }
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// print JSON object of fields
+    size_t printJson_(Print& out, int flags, uint32_t /*since*/, bool /*clear*/) override {
+        return print_(out, flags, false);
+    }
+    /// print every field (as a JSON object or MessagePack map)
+    size_t printValue_(Print& out, bool msgPack) override {
+        return print_(out, 0, msgPack);
+    }
+
+private:
+    /////////////////////////////////////////////////////////////////////////
+    /// field included by flags?
+    static bool included_(const PropertyField& field, int flags) {
+        return !(flags & PERSIST) || (field.flags & PERSIST);
+    }
+
+    /// print fields included by flags
+    size_t print_(Print& out, int flags, bool msgPack) {
+        size_t len = 0;
+        if (msgPack) {
+            uint8_t count = 0;
+            for (const auto& field : Schema::FIELDS) count += included_(field, flags) ? 1 : 0;
+            if (count < 16) {
+                len += out.write(uint8_t(0x80 | count));    // fixmap
+            } else {
+                len += out.write(uint8_t{0xDE});            // map 16
+                len += out.write(uint8_t{0});
+                len += out.write(count);
+            }
+        } else {
+            len += out.write('{');
+        }
+
+        bool first = true;
+        for (const auto& field : Schema::FIELDS) {
+            if (!included_(field, flags)) continue;
+
+            if (!msgPack && !first) len += out.write(',');
+            first = false;
+            len += serializeValue_(out, field.name, msgPack);
+            if (!msgPack) len += out.write(':');
+
+            switch (field.type) {
+            case PropertyField::BOOL:   len += serializeValue_(out, get_<bool>(values_, field), msgPack); break;
+            case PropertyField::FLOAT:  len += serializeValue_(out, get_<float>(values_, field), msgPack); break;
+            case PropertyField::INT:    len += serializeValue_(out, get_<int>(values_, field), msgPack); break;
+            case PropertyField::UINT:   len += serializeValue_(out, get_<unsigned>(values_, field), msgPack); break;
+            }
+        }
+        return msgPack ? len : len + out.write('}');
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// field value
+    template <typename T>
+    static T get_(const Values& values, const PropertyField& field) {
+        T value;
+        memcpy(&value, reinterpret_cast<const uint8_t*>(&values) + field.offset, sizeof(value));
+        return value;
+    }
+    /// assign field value
+    template <typename T>
+    static void put_(Values& values, const PropertyField& field, T value) {
+        memcpy(reinterpret_cast<uint8_t*>(&values) + field.offset, &value, sizeof(value));
+    }
+    /// field equal in a and b?
+    static bool equal_(const PropertyField& field, const Values& a, const Values& b) {
+        switch (field.type) {
+        case PropertyField::BOOL:   return get_<bool>(a, field) == get_<bool>(b, field);
+        case PropertyField::FLOAT:  return get_<float>(a, field) == get_<float>(b, field);
+        case PropertyField::INT:    return get_<int>(a, field) == get_<int>(b, field);
+        case PropertyField::UINT:   return get_<unsigned>(a, field) == get_<unsigned>(b, field);
+        }
+        return false;
+    }
+
+    Values      values_;                ///< held values
+};
+
+#endif // INCLUDED__PROPERTY_RECORD
@@ -0,0 +1,176 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+HLW8012 pulse output channel measurement
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "pulse_channel.h"
+
+namespace {
+    /// millihertz per hertz * microseconds per second
+    const uint64_t MILLIHZ_MICROS = 1000000000;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+PulseChannel::PulseChannel(Convert fromFrequency, uint32_t ticksPerMicro)
+: fromFrequency_(fromFrequency)
+, ticksPerMicro_(ticksPerMicro)
+{ }
+
+/////////////////////////////////////////////////////////////////////////////
+/// change measurement mode
+void PulseChannel::setMode(Mode mode) {
+    if (mode_ == mode) return;
+    mode_ = mode;
+    reset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// change tick rate (e.g. CPU frequency change)
+void PulseChannel::setTicksPerMicro(uint32_t ticksPerMicro) {
+    if (ticksPerMicro_ == ticksPerMicro) return;
+    ticksPerMicro_ = ticksPerMicro;
+    lastPeriod_ = 0;
+    reset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// discard any partial measurement (retains last value)
+void PulseChannel::reset() {
+    pulses_ = 0;
+    started_ = false;
+    arriving_ = false;
+    falling_ = false;
+    lastInterval_ = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// process an edge
+/// @returns true if a new value was measured
+bool PulseChannel::edge(uint64_t ticks, bool rising) {
+    ++edges_;
+    if (!rising) jitter_(ticks);
+
+    if (Mode::WIDTH == mode_) {
+        if (rising) {
+            start_ = ticks;
+            started_ = true;
+            return false;
+        }
+
+        // can't measure falling edges without a matching rising edge
+        if (!started_) {
+            ++accepted_;
+            return false;
+        }
+        started_ = false;
+
+        // 50% duty cycle => period is twice the pulse width
+        const uint64_t period = 2 * (ticks - start_);
+        if (!frequency_(period, 1)) return false;
+        ++accepted_;
+        lastEdge_ = ticks;
+        lastPeriod_ = period;
+        arriving_ = true;
+        return true;
+    }
+
+    // only count falling edges
+    if (rising) return false;
+
+    // reject glitches
+    if (started_ && (ticks - lastEdge_) < uint64_t{MIN_PERIOD_MICROS} * ticksPerMicro_) {
+        ++rejected_;
+        return false;
+    }
+    ++accepted_;
+    lastEdge_ = ticks;
+    arriving_ = true;
+
+    // open gate window
+    if (!started_) {
+        start_ = ticks;
+        pulses_ = 0;
+        started_ = true;
+        return false;
+    }
+    ++pulses_;
+
+    // adaptive gate window
+    const uint64_t elapsed = ticks - start_;
+    if (elapsed < uint64_t{GATE_MIN_MICROS} * ticksPerMicro_) return false;
+    if (pulses_ < GATE_MIN_PULSES && elapsed < uint64_t{GATE_MAX_MICROS} * ticksPerMicro_) return false;
+
+    const auto measured = frequency_(elapsed, pulses_);
+    lastPeriod_ = elapsed / pulses_;
+
+    // next window begins with this edge
+    start_ = ticks;
+    pulses_ = 0;
+    return measured;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// check for missing pulses
+/// slow pulses would otherwise hold the last value until the next one (or
+/// the gate closes), and pulses stopping (load off) would hold it forever
+/// @returns true if the value was lowered
+bool PulseChannel::idle(uint64_t nowTicks) {
+    if (!arriving_) return false;
+
+    const uint64_t sinceEdge = nowTicks - lastEdge_;
+    if (sinceEdge >= uint64_t{IDLE_ZERO_MICROS} * ticksPerMicro_) {
+        reset();
+        if (0 == value_) return false;
+        value_ = 0;
+        return true;
+    }
+
+    // overdue pulse, frequency can be at most 1/sinceEdge
+    if (sinceEdge < uint64_t{GATE_MAX_MICROS} * ticksPerMicro_ || sinceEdge <= lastPeriod_) return false;
+    const auto bound = fromFrequency_(static_cast<uint32_t>(MILLIHZ_MICROS * ticksPerMicro_ / sinceEdge));
+    if (bound >= value_) return false;
+
+    value_ = bound;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// convert count periods over ticks to a value
+/// @returns true if a value was measured
+bool PulseChannel::frequency_(uint64_t ticks, uint32_t count) {
+    // reject implausible periods
+    if (   ticks < uint64_t{MIN_PERIOD_MICROS} * ticksPerMicro_ * count
+        || ticks > uint64_t{IDLE_ZERO_MICROS} * ticksPerMicro_
+    ) {
+        ++rejected_;
+        return false;
+    }
+
+    const auto milliHz = (MILLIHZ_MICROS * ticksPerMicro_ * count) / ticks;
+    value_ = fromFrequency_(static_cast<uint32_t>(milliHz));
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// track change between consecutive falling edge intervals
+void PulseChannel::jitter_(uint64_t ticks) {
+    const uint64_t interval = ticks - lastFalling_;
+    const uint64_t lastInterval = lastInterval_;
+    const bool falling = falling_;
+    lastFalling_ = ticks;
+    falling_ = true;
+
+    // need a previous interval for comparison (restarts after idle)
+    lastInterval_ = (falling && interval < uint64_t{GATE_MAX_MICROS} * ticksPerMicro_) ? interval : 0;
+    if (0 == lastInterval_ || 0 == lastInterval) return;
+
+    // period changing (load step) isn't jitter
+    const uint64_t change = (interval > lastInterval) ? interval - lastInterval : lastInterval - interval;
+    if (change * 100 > lastInterval * JITTER_STEADY_PERCENT) return;
+    if (change > jitterMax_) jitterMax_ = static_cast<uint32_t>(change);
+}
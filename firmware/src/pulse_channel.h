@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+HLW8012 pulse output channel measurement
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__PULSE_CHANNEL
+#define INCLUDED__PULSE_CHANNEL
+
+//- includes
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// measures a HLW8012 pulse output (CF or CF1)
+///
+/// WIDTH mode measures the width of a single pulse (rising => falling edge)
+///
+/// COUNT mode counts falling edges over an adaptive gate window. The window
+/// closes after GATE_MIN_MICROS when pulses are arriving quickly, or extends
+/// out towards GATE_MAX_MICROS to collect GATE_MIN_PULSES when pulses are
+/// slow. The frequency is taken between the first and last edge of the
+/// window (reciprocal counting) so even a single pulse interval is accurate.
+///
+/// Edge times are in ticks (e.g. CPU cycles), extended to 64-bits so they
+/// don't wrap. Both modes produce a frequency which is then converted to
+/// a value, retaining the sub-microsecond resolution of the ticks.
+///
+/// Either mode only measures as pulses arrive, so idle() lowers the value
+/// when they're overdue (a load switching off stops them altogether).
+///
+/// Diagnostics track processed edges, rejected periods, and the largest
+/// change between consecutive falling edge intervals (jitter) since
+/// resetJitter(). Only changes within JITTER_STEADY_PERCENT of the interval
+/// count, larger ones are the period itself changing (load steps). With a
+/// steady load the HLW8012 output is stable, so jitter mostly reflects
+/// delays in servicing the edge interrupts.
+class PulseChannel {
+public:
+    /// conversion from frequency (mHz) to a value
+    using Convert = uint32_t (*)(uint32_t);
+
+    /// measurement mode
+    enum class Mode {
+        WIDTH,  ///< measure the width of individual pulses
+        COUNT,  ///< count pulses over a gate window
+    };
+
+    enum : uint32_t {
+        GATE_MIN_MICROS     = 250000,   ///< minimum gate window
+        GATE_MAX_MICROS     = 5000000,  ///< gate closes regardless of pulse count (provided we have an interval)
+        GATE_MIN_PULSES     = 4,        ///< pulses to count before closing a window shorter than GATE_MAX_MICROS
+        IDLE_ZERO_MICROS    = 60000000, ///< without pulses for this long reads as zero
+        MIN_PERIOD_MICROS   = 10,       ///< shorter periods are rejected as glitches
+        JITTER_STEADY_PERCENT = 5,      ///< larger interval changes are steps rather than jitter
+    };
+
+    explicit PulseChannel(Convert fromFrequency, uint32_t ticksPerMicro = 1);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// current mode
+    Mode mode() const { return mode_; }
+    void setMode(Mode mode);
+
+    /// ticks per microsecond
+    uint32_t ticksPerMicro() const { return ticksPerMicro_; }
+    void setTicksPerMicro(uint32_t ticksPerMicro);
+
+    void reset();
+
+    bool edge(uint64_t ticks, bool rising);
+    bool idle(uint64_t nowTicks);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// last measured value
+    uint32_t value() const { return value_; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// number of processed edges
+    uint32_t edges() const { return edges_; }
+    /// number of rejected (implausible) periods
+    uint32_t rejected() const { return rejected_; }
+    /// falling edges accepted as pulses (not rejected as glitches)
+    uint32_t accepted() const { return accepted_; }
+    /// maximum jitter seen since resetJitter() (ticks)
+    uint32_t jitterMax() const { return jitterMax_; }
+    /// begin a new jitter window
+    void resetJitter() { jitterMax_ = 0; }
+
+private:
+    bool frequency_(uint64_t ticks, uint32_t count);
+    void jitter_(uint64_t ticks);
+
+    Convert     fromFrequency_;         ///< frequency (mHz) to value
+    uint32_t    ticksPerMicro_{1};      ///< ticks per microsecond
+    Mode        mode_{Mode::WIDTH};     ///< measurement mode
+
+    uint32_t    value_{0};              ///< last measured value
+    uint64_t    start_{0};              ///< pulse (WIDTH) or gate window (COUNT) start
+    uint64_t    lastEdge_{0};           ///< last measured (WIDTH) or counted (COUNT) falling edge
+    uint64_t    lastPeriod_{0};         ///< last measured period
+    uint32_t    pulses_{0};             ///< pulses counted within gate window (COUNT)
+    bool        started_{false};        ///< start_ is valid
+    bool        arriving_{false};       ///< lastEdge_ is valid (pulses are arriving)
+
+    uint64_t    lastFalling_{0};        ///< last falling edge
+    uint64_t    lastInterval_{0};       ///< last falling edge interval (0 = none)
+    bool        falling_{false};        ///< lastFalling_ is valid
+    uint32_t    edges_{0};              ///< processed edges
+    uint32_t    rejected_{0};           ///< rejected periods
+    uint32_t    accepted_{0};           ///< falling edges accepted as pulses
+    uint32_t    jitterMax_{0};          ///< maximum steady interval change seen (ticks)
+};
+
+#endif // INCLUDED__PULSE_CHANNEL
@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Raw HLW8012 pulse trace capture
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "pulse_trace.h"
+#include <cstring>
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+PulseTrace::PulseTrace() {
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = MAGIC;
+    header_.version = VERSION;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// start capturing count records, discarding any previous trace
+/// @returns false if count is invalid, or the trace is being downloaded
+bool PulseTrace::start(uint32_t count, uint8_t ticksPerMicro, uint8_t mode) {
+    if (0 == count || count > CAPACITY || reading()) return false;
+
+    header_.ticksPerMicro = ticksPerMicro;
+    header_.mode = mode;
+    header_.requested = static_cast<uint16_t>(count);
+    header_.count = 0;
+    header_.overflows = 0;
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// record an edge (if capturing)
+void PulseTrace::add(uint32_t cycles, uint8_t pin, bool rising) {
+    if (!capturing()) return;
+
+    auto& record = records_[header_.count++];
+    record.cycles = cycles;
+    record.pin = pin;
+    record.rising = rising ? 1 : 0;
+    record.reserved = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read blob bytes from offset
+/// @returns number of bytes read (0 at end)
+size_t PulseTrace::read(size_t offset, uint8_t* buffer, size_t size) const {
+    size_t total = 0;
+
+    if (offset < sizeof(Header)) {
+        auto len = sizeof(Header) - offset;
+        if (len > size) len = size;
+        memcpy(buffer, reinterpret_cast<const uint8_t*>(&header_) + offset, len);
+        total += len;
+        offset += len;
+    }
+
+    const auto end = this->size();
+    if (offset < end && total < size) {
+        auto len = end - offset;
+        if (len > size - total) len = size - total;
+        memcpy(buffer + total, reinterpret_cast<const uint8_t*>(records_) + (offset - sizeof(Header)), len);
+        total += len;
+    }
+    return total;
+}
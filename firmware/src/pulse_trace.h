@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Raw HLW8012 pulse trace capture
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__PULSE_TRACE
+#define INCLUDED__PULSE_TRACE
+
+//- includes
+#include <cstddef>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// captures raw CF/CF1 edges into a preallocated buffer
+///
+/// Edges are recorded exactly as captured by the ISRs (32-bit CCOUNT), so
+/// a trace can be downloaded and replayed through PulseChannel offline.
+/// The blob is a Header followed by count Records (little endian).
+///
+/// Downloads hold a Reader, so a new capture can't overwrite the trace
+/// part way through a download.
+class PulseTrace {
+public:
+    enum : uint32_t {
+        CAPACITY    = 512,          ///< maximum records (4 KB)
+        MAGIC       = 0x43525450,   ///< "PTRC"
+        VERSION     = 1,            ///< blob format version
+    };
+
+    /// blob header
+    struct Header {
+        uint32_t    magic;          ///< MAGIC
+        uint8_t     version;        ///< VERSION
+        uint8_t     ticksPerMicro;  ///< CCOUNT ticks per microsecond
+        uint8_t     mode;           ///< PulseChannel::Mode at time of capture
+        uint8_t     reserved;       ///< reserved (0)
+        uint16_t    requested;      ///< requested records
+        uint16_t    count;          ///< captured records
+        uint32_t    overflows;      ///< edges dropped by the ISRs during capture
+    };
+    static_assert(sizeof(Header) == 16, "unexpected Header size");
+
+    /// captured edge
+    struct Record {
+        uint32_t    cycles;         ///< CPU cycle count (CCOUNT) at time of edge
+        uint8_t     pin;            ///< pin the edge occurred on
+        uint8_t     rising;         ///< rising (1) or falling (0) edge
+        uint16_t    reserved;       ///< reserved (0)
+    };
+    static_assert(sizeof(Record) == 8, "unexpected Record size");
+
+    /////////////////////////////////////////////////////////////////////////
+    /// holds the trace for a download (preventing a new capture)
+    class Reader {
+    public:
+        explicit Reader(const PulseTrace& trace)
+        : trace_(trace)
+        { ++trace_.readers_; }
+        ~Reader() { --trace_.readers_; }
+
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        /// blob size (bytes)
+        size_t size() const { return trace_.size(); }
+        /// read blob bytes from offset
+        size_t read(size_t offset, uint8_t* buffer, size_t size) const { return trace_.read(offset, buffer, size); }
+
+    private:
+        const PulseTrace& trace_;       ///< trace being read
+    };
+
+    PulseTrace();
+
+    bool start(uint32_t count, uint8_t ticksPerMicro, uint8_t mode);
+    void add(uint32_t cycles, uint8_t pin, bool rising);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// capture in progress?
+    bool capturing() const { return header_.count < header_.requested; }
+    /// requested records
+    uint32_t requested() const { return header_.requested; }
+    /// captured records
+    uint32_t count() const { return header_.count; }
+    /// download in progress?
+    bool reading() const { return readers_ > 0; }
+
+    /// edges dropped during capture
+    void setOverflows(uint32_t overflows) { header_.overflows = overflows; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// blob size (bytes)
+    size_t size() const { return sizeof(Header) + header_.count * sizeof(Record); }
+    size_t read(size_t offset, uint8_t* buffer, size_t size) const;
+
+private:
+    Header      header_;                ///< blob header
+    Record      records_[CAPACITY];     ///< captured edges
+    mutable uint8_t readers_{0};        ///< Readers holding the trace
+};
+
+#endif // INCLUDED__PULSE_TRACE
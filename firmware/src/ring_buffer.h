@@ -0,0 +1,80 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Fixed size single producer/single consumer ring buffer
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__RING_BUFFER
+#define INCLUDED__RING_BUFFER
+
+//- includes
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// lock-free single producer/single consumer ring buffer
+/// the producer (typically an ISR) only ever writes head_ while the
+/// consumer (main loop) only ever writes tail_, so no locking is required
+template <typename T, size_t SIZE>
+class RingBufferT {
+    static_assert(SIZE >= 2 && 0 == (SIZE & (SIZE - 1)), "SIZE must be a power of two");
+public:
+    RingBufferT() = default;
+
+    // noncopyable
+    RingBufferT(const RingBufferT&) = delete;
+    // nonassignable
+    RingBufferT& operator=(const RingBufferT&) = delete;
+
+    /////////////////////////////////////////////////////////////////////////
+    /// maximum number of held items
+    static constexpr size_t capacity() { return SIZE - 1; }
+
+    /// buffer empty?
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+    /// number of held items
+    size_t size() const {
+        return (head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire)) & MASK;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// push item (producer)
+    /// @returns false if the buffer is full
+    inline __attribute__((always_inline)) bool push(const T& item) {
+        const auto head = head_.load(std::memory_order_relaxed);
+        const auto next = (head + 1) & MASK;
+        if (next == tail_.load(std::memory_order_acquire)) return false; // full
+        items_[head] = item;
+        head_.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// pop item (consumer)
+    /// @returns false if the buffer is empty
+    bool pop(T& item) {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false; // empty
+        item = items_[tail];
+        tail_.store((tail + 1) & MASK, std::memory_order_release);
+        return true;
+    }
+
+    /// discard all held items (consumer)
+    void clear() {
+        tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+private:
+    static constexpr uint32_t MASK = SIZE - 1;
+
+    T                       items_[SIZE];   ///< held items
+    std::atomic<uint32_t>   head_{0};       ///< next slot to write (producer)
+    std::atomic<uint32_t>   tail_{0};       ///< next slot to read (consumer)
+};
+
+#endif // INCLUDED__RING_BUFFER
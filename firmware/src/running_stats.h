@@ -0,0 +1,57 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Incremental statistics
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__RUNNING_STATS
+#define INCLUDED__RUNNING_STATS
+
+//- includes
+#include <cmath>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// min/max/mean/standard deviation accumulated one value at a time
+/// uses Welford's algorithm, which avoids the cancellation of sum of squares
+class RunningStats {
+public:
+    /////////////////////////////////////////////////////////////////////////
+    /// add value
+    void add(double value) {
+        ++count_;
+        if (1 == count_ || value < min_) min_ = value;
+        if (1 == count_ || value > max_) max_ = value;
+
+        const auto delta = value - mean_;
+        mean_ += delta / count_;
+        m2_ += delta * (value - mean_);
+    }
+
+    /// restart accumulating
+    void reset() { *this = RunningStats{}; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// number of values
+    uint32_t count() const { return count_; }
+    /// minimum value
+    double min() const { return min_; }
+    /// maximum value
+    double max() const { return max_; }
+    /// mean value
+    double mean() const { return mean_; }
+    /// population variance
+    double variance() const { return (count_ > 0) ? m2_ / count_ : 0; }
+    /// population standard deviation
+    double stddev() const { return std::sqrt(variance()); }
+
+private:
+    uint32_t    count_{0};  ///< number of values
+    double      min_{0};    ///< minimum value
+    double      max_{0};    ///< maximum value
+    double      mean_{0};   ///< running mean
+    double      m2_{0};     ///< sum of squared differences from the mean
+};
+
+#endif // INCLUDED__RUNNING_STATS
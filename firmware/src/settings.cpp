@@ -8,19 +8,37 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 
 //- includes
 #include "settings.h"
+#include "cadence.h"
+#include "overpower.h"
+#include "pulse_trace.h"
 #include "utils.h"
 #include "version.h"
 // #include <ip_addr.h>
 
 extern "C" unsigned long millis();
 
+namespace {
+    /// power updates, ignoring changes within 0.5 W or 1%
+    const PropertyFloatDeadband::Deadband POWER_DEADBAND{ 0.5f, 0.01f, 0.1f };
+    /// voltage updates, ignoring changes within 0.5 V
+    const PropertyFloatDeadband::Deadband VOLTAGE_DEADBAND{ 0.5f, 0.0f, 0.1f };
+}
+
 /// command methods to function map
 const Settings::MethodFuncPair Settings::methods_[] = {
+    { "events",  &Settings::methodEvents_  },
+    { "get",     &Settings::methodGet_     },
+    { "history", &Settings::methodHistory_ },
+    { "meter",   &Settings::methodMeter_   },
     { "network", &Settings::methodNetwork_ },
     { "ping",    &Settings::methodPing_    },
+    { "protect", &Settings::methodProtect_ },
     { "relay",   &Settings::methodRelay_   },
+    { "schema",  &Settings::methodSchema_  },
+    { "set",     &Settings::methodSet_     },
     { "state",   &Settings::methodState_   },
     { "test",    &Settings::methodTest_    },
+    { "trace",   &Settings::methodTrace_   },
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -28,32 +46,83 @@ Settings::Settings()
 : propRelay_{ &propRoot_, "relay" }
 , propSys_{ &propRoot_, "sys" }
 , propSysNet_{ &propSys_, "net" }
+, propSysMeter_{ &propSys_, "meter" }
+, propSysMeterMode_{ &propSysMeter_, "mode", "width", Property::PERSIST }
+, propSysMeterIntervalMin_{ &propSysMeter_, "intervalMin", Cadence::DEFAULT_MIN_MILLIS, Property::PERSIST }
+, propSysMeterIntervalMax_{ &propSysMeter_, "intervalMax", Cadence::DEFAULT_MAX_MILLIS, Property::PERSIST }
 , propTest_{ &propRoot_, "test" }
-, propTestInt_{ &propTest_, "int", 42 }
-, propPower_{ &propRoot_, "power", 0 }
+, propTestInt_{ &propTest_, "int", 42, Property::WRITABLE }
+, propPower_{ &propRoot_, "power", 0, POWER_DEADBAND }
+, propProtect_{ &propRoot_, "protect" }
+, propProtectLimit_{ &propProtect_, "limit", 0, Property::PERSIST }
+, propProtectInrush_{ &propProtect_, "inrush", 0, Property::PERSIST }
+, propProtectFault_{ &propProtect_, "fault", false, Property::PERSIST }
+, propProtectTrips_{ &propProtect_, "trips", 0, Property::PERSIST }
+, propProtectTripPower_{ &propProtect_, "tripPower", 0, Property::PERSIST }
+, propProtectTripTime_{ &propProtect_, "tripTime", 0, Property::PERSIST }
 , propVersion_{ &propRoot_, "version", version::STRING }
 , propVersionGit_{ &propRoot_, "gitRev", version::GIT_REV }
-, propVoltage_{ &propRoot_, "voltage", 0 }
+, propVoltage_{ &propRoot_, "voltage", 0, VOLTAGE_DEADBAND }
+, propStats_{ &propRoot_, "stats" }
+, statsWindows_{
+    { &propStats_, "short", 10 },
+    { &propStats_, "medium", 60 },
+    { &propStats_, "long", 900 },
+}
+, propEvents_{ &propRoot_, "events" }
+, propEventsCount_{ &propEvents_, "count", 0 }
+, propEventsLast_{ &propEvents_, "last" }
+, propEventsLastTime_{ &propEventsLast_, "time", 0 }
+, propEventsLastDuration_{ &propEventsLast_, "duration", 0 }
+, propEventsLastBefore_{ &propEventsLast_, "before", 0 }
+, propEventsLastAfter_{ &propEventsLast_, "after", 0 }
 { }
 
 /////////////////////////////////////////////////////////////////////////////
 void Settings::begin() {
-    lastMillisDirty_ = millis();
+    // consumers hear of changes on the next tick, however many there were
+    // (not on construction, a global Settings may precede the observer list)
+    propRoot_.observe([this](Property&) { notifyChanges_(); }, true);
+
+    lastMillisChanges_ = millis();
     lastMillisPersist_ = millis();
+    lastMillisHistory_ = millis();
 }
 
 /////////////////////////////////////////////////////////////////////////////
 void Settings::tick() {
     const auto now = millis();
 
-    // process dirty properties
-    if ((now - lastMillisDirty_) >= 100) {
-        lastMillisDirty_ = now;
+    // property changes since the last tick
+    Property::notifyDeferred();
+
+    // without changes, let consumers which couldn't take theirs catch up
+    if ((now - lastMillisChanges_) >= 1000) notifyChanges_();
 
-        if (onDirtyProperties_ && propRoot_.dirty()) {
-            DynamicJsonDocument docProps{Settings::JSON_STATE_SIZE};
-            propRoot_.toJson(docProps, Property::DIRTY);
-            if (!docProps.isNull()) onDirtyProperties_(docProps);
+    // sample history each second (without drifting)
+    if ((now - lastMillisHistory_) >= 1000) {
+        lastMillisHistory_ += 1000;
+        if ((now - lastMillisHistory_) >= 1000) lastMillisHistory_ = now; // fell behind
+
+        const History::Sample sample{
+            History::toDeci(measWatts_),
+            History::toDeci(measVolts_),
+        };
+        history_.add(sample);
+        if (onSample_) onSample_(sample);
+
+        for (auto& window : statsWindows_) window.add(measWatts_, measVolts_);
+
+        // publish load steps as they're detected (a few a day)
+        if (steps_.add(measWatts_, utils::unixTime())) {
+            const auto& event = steps_.at(steps_.end() - 1);
+            printf("Step %.1f W -> %.1f W\r\n", event.before, event.after);
+
+            propEventsLastTime_.set(event.time);
+            propEventsLastDuration_.set(event.duration);
+            propEventsLastBefore_.set(event.before);
+            propEventsLastAfter_.set(event.after);
+            propEventsCount_.set(steps_.end());
         }
     }
 
@@ -63,24 +132,35 @@ void Settings::tick() {
 
         if (onPersistProperties_ && propRoot_.persistDirty()) {
             printf("Saving properties...\r\n");
-            DynamicJsonDocument docProps{Settings::JSON_STATE_SIZE};
-            propRoot_.toJson(docProps, Property::PERSIST);
-            if (!docProps.isNull()) onPersistProperties_(docProps);
+            onPersistProperties_(propRoot_, Property::PERSIST);
         }
     }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// offer property changes to consumers (each takes those since its cursor)
+void Settings::notifyChanges_() {
+    lastMillisChanges_ = millis();
+    for (const auto& onChanges : onChangedProperties_) onChanges(propRoot_);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// load settings from JSON stream
 void Settings::loadFrom(Stream& config) {
     DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
     deserializeJson(doc, config);
-    propRoot_.fromJson(doc.to<JsonObject>());
+    propRoot_.fromJson(doc.as<JsonObject>());
 }
 
 /////////////////////////////////////////////////////////////////////////////
 /// update measurements
-void Settings::updateMeasurements(double watts, double volts) {
+/// history and statistics always see the latest measurements,
+/// publish controls whether the properties are updated
+void Settings::updateMeasurements(double watts, double volts, bool publish) {
+    measWatts_ = watts;
+    measVolts_ = volts;
+    if (!publish) return;
+
     propPower_.set(watts);
     propVoltage_.set(volts);
 }
@@ -97,6 +177,148 @@ JsonRpcError Settings::call(const char* method, const JsonVariant& params, JsonD
     return JsonRpcError::METHOD_NOT_FOUND;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// events - retrieve detected load steps
+/// params (all optional):
+///   start - sequence number of the first event (defaults to most recent events)
+///   count - number of events (up to EVENTS_PAGE_SIZE)
+/// next is the start of the following page
+JsonRpcError Settings::methodEvents_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.isNull() && !params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    auto count = params["count"] | uint32_t{EVENTS_PAGE_SIZE};
+    if (count > EVENTS_PAGE_SIZE) count = EVENTS_PAGE_SIZE;
+
+    const auto begin = steps_.begin();
+    const auto end = steps_.end();
+
+    auto start = (end - begin > count) ? end - count : begin;
+    if (params["start"].is<uint32_t>()) start = params["start"].as<uint32_t>();
+    if (start < begin) start = begin;
+    if (start > end) start = end;
+    if (count > end - start) count = end - start;
+
+    auto obj = result.to<JsonObject>();
+    obj["start"] = start;
+    obj["next"] = start + count;
+    obj["end"] = end;
+
+    auto events = obj.createNestedArray("events");
+    steps_.read(start, count, [&events](uint32_t, const StepDetector::Event& event) {
+        auto e = events.createNestedObject();
+        e["time"] = event.time;
+        e["duration"] = event.duration;
+        e["before"] = event.before;
+        e["after"] = event.after;
+    });
+
+    return JsonRpcError::NO_ERROR;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// get - retrieve a single property
+/// params:
+///   path - dotted property path (e.g. "sys.net.cur.ipv4Address")
+JsonRpcError Settings::methodGet_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    const char* path = params["path"];
+    if (!path) { result.set("Missing path"); return JsonRpcError::INVALID_PARAMS; }
+
+    auto prop = propRoot_.find(path);
+    if (!prop) { result.set("Unknown path"); return JsonRpcError::INVALID_PARAMS; }
+
+    DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
+    auto obj = doc.to<JsonObject>();
+    prop->toJson(obj);
+    result.set(obj[prop->name()]);
+    return JsonRpcError::NO_ERROR;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// history - retrieve measurement history
+/// params (all optional):
+///   level - 0 (1 s), 1 (1 min), 2 (1 h)
+///   start - sequence number of the first sample (defaults to most recent samples)
+///   count - number of samples (up to HISTORY_PAGE_SIZE)
+/// power and voltage are returned in 0.1 units (scale)
+/// next is the start of the following page
+JsonRpcError Settings::methodHistory_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.isNull() && !params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    const auto level = params["level"] | 0u;
+    if (level >= History::LEVELS) { result.set("Invalid level"); return JsonRpcError::INVALID_PARAMS; }
+
+    auto count = params["count"] | uint32_t{HISTORY_PAGE_SIZE};
+    if (count > HISTORY_PAGE_SIZE) count = HISTORY_PAGE_SIZE;
+
+    const auto begin = history_.begin(level);
+    const auto end = history_.end(level);
+
+    auto start = (end - begin > count) ? end - count : begin;
+    if (params["start"].is<uint32_t>()) start = params["start"].as<uint32_t>();
+    if (start < begin) start = begin;
+    if (start > end) start = end;
+    if (count > end - start) count = end - start;
+
+    auto obj = result.to<JsonObject>();
+    obj["interval"] = history_.interval(level);
+    obj["start"] = start;
+    obj["next"] = start + count;
+    obj["end"] = end;
+    obj["scale"] = 0.1;
+
+    auto power = obj.createNestedArray("power");
+    auto voltage = obj.createNestedArray("voltage");
+    history_.read(level, start, count, [&power, &voltage](uint32_t, const History::Sample& sample) {
+        power.add(sample.deciWatts);
+        voltage.add(sample.deciVolts);
+    });
+
+    return JsonRpcError::NO_ERROR;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// meter - apply metering settings
+JsonRpcError Settings::methodMeter_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    // optional measurement mode
+    const char* mode = params["mode"];
+    if (mode && 0 != strcmp(mode, "width") && 0 != strcmp(mode, "count")) { result.set("Invalid mode"); return JsonRpcError::INVALID_PARAMS; }
+
+    // optional statistics windows (seconds)
+    const auto windows = params["windows"];
+    if (!windows.isNull()) {
+        if (!windows.is<JsonArray>() || windows.size() != STATS_WINDOWS) { result.set("Invalid windows"); return JsonRpcError::INVALID_PARAMS; }
+        for (const auto window : windows.as<JsonArray>()) {
+            const auto seconds = window.as<unsigned>();
+            if (!window.is<unsigned>() || 0 == seconds || seconds > StatsWindow::SECONDS_MAX) { result.set("Invalid windows"); return JsonRpcError::INVALID_PARAMS; }
+        }
+    }
+
+    // optional publishing intervals (ms)
+    const auto intervalMin = params["intervalMin"] | propSysMeterIntervalMin_.value();
+    const auto intervalMax = params["intervalMax"] | propSysMeterIntervalMax_.value();
+    if (intervalMin < Cadence::LIMIT_MIN_MILLIS || intervalMin > Cadence::LIMIT_MAX_MILLIS) { result.set("Invalid intervalMin"); return JsonRpcError::INVALID_PARAMS; }
+    if (intervalMax < intervalMin || intervalMax > Cadence::LIMIT_MAX_MILLIS) { result.set("Invalid intervalMax"); return JsonRpcError::INVALID_PARAMS; }
+
+    // apply
+    if (mode) propSysMeterMode_.set(mode);
+    propSysMeterIntervalMin_.set(intervalMin);
+    propSysMeterIntervalMax_.set(intervalMax);
+    if (!windows.isNull()) {
+        for (size_t i = 0; i < STATS_WINDOWS; ++i) {
+            statsWindows_[i].setSeconds(windows[i].as<unsigned>());
+        }
+    }
+
+    if (onMeter_) onMeter_();
+
+    result.set(true);
+    return JsonRpcError::NO_ERROR;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// network - apply new network settings
 JsonRpcError Settings::methodNetwork_(const JsonVariant& params, JsonDocument& result) {
@@ -152,12 +374,50 @@ JsonRpcError Settings::methodPing_(const JsonVariant& /*params*/, JsonDocument&
     return JsonRpcError::NO_ERROR;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// protect - overpower protection settings
+/// params (all optional):
+///   limit - power limit (W, 0 = disabled)
+///   inrush - time allowed above the limit (ms)
+///   clear - true to clear a latched fault
+JsonRpcError Settings::methodProtect_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    const auto limit = params["limit"] | propProtectLimit_.value();
+    if (!(limit >= 0 && limit <= PROTECT_LIMIT_MAX)) { result.set("Invalid limit"); return JsonRpcError::INVALID_PARAMS; }
+
+    const auto inrush = params["inrush"] | propProtectInrush_.value();
+    if (inrush > Overpower::INRUSH_MAX_MILLIS) { result.set("Invalid inrush"); return JsonRpcError::INVALID_PARAMS; }
+
+    // apply
+    propProtectLimit_.set(limit);
+    propProtectInrush_.set(inrush);
+    if (params["clear"].as<bool>()) propProtectFault_.set(false);
+
+    if (onProtect_) onProtect_();
+
+    result.set(true);
+    return JsonRpcError::NO_ERROR;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// record an overpower trip (relay already opened), latching the fault
+void Settings::tripProtect(float watts) {
+    printf("Overpower %.1f W, relay opened\r\n", watts);
+
+    propProtectFault_.set(true);
+    propProtectTrips_.set(propProtectTrips_.value() + 1);
+    propProtectTripPower_.set(watts);
+    propProtectTripTime_.set(utils::unixTime());
+    setRelay(false);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// relay - set relay
 JsonRpcError Settings::methodRelay_(const JsonVariant& params, JsonDocument& result) {
     if (!params.is<bool>()) { result.set("Expected boolean"); return JsonRpcError::INVALID_PARAMS; }
 
-    setRelay(params.as<bool>());
+    if (!setRelay(params.as<bool>())) { result.set("Overpower fault"); return JsonRpcError::FAULT; }
 
     result.set(true);
     return JsonRpcError::NO_ERROR;
@@ -165,11 +425,44 @@ JsonRpcError Settings::methodRelay_(const JsonVariant& params, JsonDocument& res
 
 /////////////////////////////////////////////////////////////////////////////
 /// update relay state
-void Settings::setRelay(bool state) {
+/// @returns false if the relay can't be closed (overpower fault latched)
+bool Settings::setRelay(bool state) {
+    if (state && propProtectFault_.value()) return false;
+
     if (propRelay_.value() != state) {
         propRelay_.set(state);
         if (onRelay_) onRelay_(state);
     }
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// schema - property tree with the MessagePack id of each leaf in place of its value
+/// ids are stable for a given firmware, so clients need only fetch this once
+JsonRpcError Settings::methodSchema_(const JsonVariant& /*params*/, JsonDocument& result) {
+    propRoot_.toJsonSchema(result);
+    return JsonRpcError::NO_ERROR;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// set - assign a single (writable) property
+/// params:
+///   path - dotted property path
+///   value - new value (of the property's type)
+JsonRpcError Settings::methodSet_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    const char* path = params["path"];
+    if (!path) { result.set("Missing path"); return JsonRpcError::INVALID_PARAMS; }
+
+    auto prop = propRoot_.find(path);
+    if (!prop) { result.set("Unknown path"); return JsonRpcError::INVALID_PARAMS; }
+    if (!prop->writable()) { result.set("Read only"); return JsonRpcError::INVALID_PARAMS; }
+
+    if (!prop->assign(params["value"])) { result.set("Invalid value"); return JsonRpcError::INVALID_PARAMS; }
+
+    result.set(true);
+    return JsonRpcError::NO_ERROR;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -179,6 +472,22 @@ JsonRpcError Settings::methodState_(const JsonVariant& /*params*/, JsonDocument&
     return JsonRpcError::NO_ERROR;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// trace - capture raw CF/CF1 edges (download from /api/v1/trace)
+/// params:
+///   count - number of edges to capture (up to PulseTrace::CAPACITY)
+JsonRpcError Settings::methodTrace_(const JsonVariant& params, JsonDocument& result) {
+    if (!params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    const auto count = params["count"] | 0u;
+    if (0 == count || count > PulseTrace::CAPACITY) { result.set("Invalid count"); return JsonRpcError::INVALID_PARAMS; }
+
+    if (!onTrace_) { result.set("Trace unavailable"); return JsonRpcError::INTERNAL_ERROR; }
+    if (!onTrace_(count)) { result.set("Trace busy"); return JsonRpcError::BUSY; }
+    result.set(true);
+    return JsonRpcError::NO_ERROR;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// test - used for testing the RPC interface
 JsonRpcError Settings::methodTest_(const JsonVariant& /*params*/, JsonDocument& result) {
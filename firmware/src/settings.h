@@ -9,10 +9,14 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 #define INCLUDED__SETTINGS
 
 //- includes
+#include "history.h"
 #include "property.h"
+#include "stats_window.h"
+#include "step_detector.h"
 #include <IPAddress.h>
 #include <functional>
 #include <memory>
+#include <vector>
 
 //- forwards
 class Stream;
@@ -27,6 +31,8 @@ enum class JsonRpcError {
     INVALID_PARAMS      = -32602,   ///< Invalid params - Invalid method parameter(s)
     INTERNAL_ERROR      = -32603,   ///< Internal error - Internal JSON-RPC error
     // SERVER_ERROR = -32000 to -32099    Server error    Reserved for implementation-defined server-errors.
+    FAULT               = -32000,   ///< Server error - Protection fault latched
+    BUSY                = -32001,   ///< Server error - Resource in use (e.g. trace being downloaded)
 };
 
 /////////////////////////////////////////////////////////////////////////////
@@ -36,6 +42,10 @@ public:
     enum {
         JSON_REQUEST_SIZE   = 512,  ///< how big of a JSON request we can expect
         JSON_STATE_SIZE     = 4096, ///< JSON limit
+        HISTORY_PAGE_SIZE   = 100,  ///< maximum samples returned per history call (fits JSON_STATE_SIZE)
+        EVENTS_PAGE_SIZE    = StepDetector::EVENTS, ///< maximum events returned per events call
+        STATS_WINDOWS       = 3,    ///< number of statistics windows
+        PROTECT_LIMIT_MAX   = 4000, ///< highest overpower limit (W)
     };
     /// network settings to apply
     struct Network {
@@ -52,11 +62,25 @@ public:
     using NetworkUPtr = std::unique_ptr<Network>;
 
     /// callback for property notifications
-    using FuncOnProperties = std::function<void (const JsonDocument)>;
+    /// props.printJson(out, flags) streams the properties (clearing their flags),
+    /// props.measureJson(flags) measures them beforehand
+    using FuncOnProperties = std::function<void (PropertyNode& props, int flags)>;
+    /// callback for property changes
+    /// consumers keep their own cursor, taking props.printJson(out, 0, since) when
+    /// props.changed() is beyond it, then moving it on to Property::generation()
+    using FuncOnChanges = std::function<void (PropertyNode& props)>;
     /// callback on relay change
     using FuncOnRelay = std::function<void (bool)>;
     /// callback on network settings
     using FuncOnNetwork = std::function<bool (NetworkUPtr&&)>;
+    /// callback on metering settings change
+    using FuncOnMeter = std::function<void ()>;
+    /// callback on protection settings change
+    using FuncOnProtect = std::function<void ()>;
+    /// callback to start a pulse trace capture
+    using FuncOnTrace = std::function<bool (unsigned count)>;
+    /// callback on each (1 s) history sample
+    using FuncOnSample = std::function<void (const History::Sample&)>;
 
     Settings();
 
@@ -76,11 +100,15 @@ public:
     void toJson(JsonDocument& doc) {
         propRoot_.toJson(doc);
     }
+    /// print JSON straight to out
+    size_t printJson(Print& out) {
+        return propRoot_.printJson(out);
+    }
 
     /////////////////////////////////////////////////////////////////////////
-    /// dirty properties
-    void onDirtyProperties(FuncOnProperties onDirtyProperties) {
-        onDirtyProperties_ = std::move(onDirtyProperties);
+    /// property changes (any number of consumers, called on the loop turn after a change)
+    void onChangedProperties(FuncOnChanges onChanges) {
+        onChangedProperties_.push_back(std::move(onChanges));
     }
     /// persist properties
     void onPersistProperties(FuncOnProperties onPersistProperties) {
@@ -94,18 +122,62 @@ public:
     void onRelay(FuncOnRelay onRelay) {
         onRelay_ = std::move(onRelay);
     }
+    /// metering settings changes
+    void onMeter(FuncOnMeter onMeter) {
+        onMeter_ = std::move(onMeter);
+    }
+    /// protection settings changes
+    void onProtect(FuncOnProtect onProtect) {
+        onProtect_ = std::move(onProtect);
+    }
+    /// pulse trace capture requests
+    void onTrace(FuncOnTrace onTrace) {
+        onTrace_ = std::move(onTrace);
+    }
+    /// history samples
+    void onSample(FuncOnSample onSample) {
+        onSample_ = std::move(onSample);
+    }
 
     /// current relay value
     bool relay() { return propRelay_.value(); }
-    void setRelay(bool state);
+    bool setRelay(bool state);
 
     /////////////////////////////////////////////////////////////////////////
+    /// root
+    PropertyNode& propRoot() { return propRoot_; }
     /// sys.net
     PropertyNode& propSysNet() { return propSysNet_; }
+    /// sys.meter
+    PropertyNode& propSysMeter() { return propSysMeter_; }
+
+    /// metering mode ("width" or "count")
+    const String& meterMode() const { return propSysMeterMode_.value(); }
+    /// minimum measurement publishing interval (ms)
+    unsigned meterIntervalMin() const { return propSysMeterIntervalMin_.value(); }
+    /// maximum (steady) measurement publishing interval (ms)
+    unsigned meterIntervalMax() const { return propSysMeterIntervalMax_.value(); }
+
+    /// overpower limit (W, 0 = disabled)
+    float protectLimit() const { return propProtectLimit_.value(); }
+    /// time allowed above the limit (ms)
+    unsigned protectInrush() const { return propProtectInrush_.value(); }
+    /// overpower fault latched? (relay can't be closed)
+    bool protectFault() const { return propProtectFault_.value(); }
+    void tripProtect(float watts);
+
+    /// measurement history
+    History& history() { return history_; }
+
+    /// load steps detected
+    StepDetector& steps() { return steps_; }
+
+    /// statistics window
+    const StatsWindow& statsWindow(size_t index) const { return statsWindows_[index]; }
 
     JsonRpcError call(const char* method, const JsonVariant& params, JsonDocument& result);
 
-    void updateMeasurements(double watts, double volts);
+    void updateMeasurements(double watts, double volts, bool publish = true);
 
 private:
     /// member function pointer for handling methods
@@ -116,30 +188,70 @@ private:
     /// collection of methods to member functions
     static const MethodFuncPair methods_[];
 
+    void notifyChanges_();
+
+    JsonRpcError methodEvents_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodGet_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodHistory_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodMeter_(const JsonVariant& params, JsonDocument& result);
     JsonRpcError methodNetwork_(const JsonVariant& params, JsonDocument& result);
     JsonRpcError methodPing_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodProtect_(const JsonVariant& params, JsonDocument& result);
     JsonRpcError methodRelay_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodSchema_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodSet_(const JsonVariant& params, JsonDocument& result);
     JsonRpcError methodState_(const JsonVariant& params, JsonDocument& result);
+    JsonRpcError methodTrace_(const JsonVariant& params, JsonDocument& result);
     JsonRpcError methodTest_(const JsonVariant& params, JsonDocument& result);
 
     PropertyNode            propRoot_;
     PropertyBool            propRelay_;
     PropertyNode            propSys_;
     PropertyNode            propSysNet_;
+    PropertyNode            propSysMeter_;
+    PropertyString          propSysMeterMode_;
+    PropertyUInt            propSysMeterIntervalMin_;
+    PropertyUInt            propSysMeterIntervalMax_;
     PropertyNode            propTest_;
     PropertyInt             propTestInt_;
-    PropertyFloat           propPower_;
+    PropertyFloatDeadband   propPower_;
+    PropertyNode            propProtect_;
+    PropertyFloat           propProtectLimit_;
+    PropertyUInt            propProtectInrush_;
+    PropertyBool            propProtectFault_;
+    PropertyUInt            propProtectTrips_;
+    PropertyFloat           propProtectTripPower_;
+    PropertyUInt            propProtectTripTime_;
     PropertyString          propVersion_;
     PropertyString          propVersionGit_;
-    PropertyFloat           propVoltage_;
+    PropertyFloatDeadband   propVoltage_;
+    PropertyNode            propStats_;
+    StatsWindow             statsWindows_[STATS_WINDOWS];
+    PropertyNode            propEvents_;
+    PropertyUInt            propEventsCount_;
+    PropertyNode            propEventsLast_;
+    PropertyUInt            propEventsLastTime_;
+    PropertyUInt            propEventsLastDuration_;
+    PropertyFloat           propEventsLastBefore_;
+    PropertyFloat           propEventsLastAfter_;
 
-    FuncOnProperties        onDirtyProperties_;     ///< on dirty property notification
+    std::vector<FuncOnChanges> onChangedProperties_; ///< on property changes (per consumer)
     FuncOnProperties        onPersistProperties_;   ///< on persist property
-    unsigned long           lastMillisDirty_{0};    ///< last dirty check
+    unsigned long           lastMillisChanges_{0};  ///< last change notification (or catch up)
     unsigned long           lastMillisPersist_{0};  ///< last persist check
+    unsigned long           lastMillisHistory_{0};  ///< last history sample
+
+    History                 history_;               ///< measurement history
+    StepDetector            steps_;                 ///< load step detection
+    float                   measWatts_{0};          ///< last measured power (before deadband)
+    float                   measVolts_{0};          ///< last measured voltage (before deadband)
 
     FuncOnNetwork           onNetwork_;             ///< on network settings
     FuncOnRelay             onRelay_;               ///< on relay
+    FuncOnMeter             onMeter_;               ///< on metering settings
+    FuncOnProtect           onProtect_;             ///< on protection settings
+    FuncOnTrace             onTrace_;               ///< on pulse trace capture
+    FuncOnSample            onSample_;              ///< on history sample
 
     bool                    need_reboot_{false};    ///< need to perform a reboot
 };
@@ -5,16 +5,16 @@ ESP8266 Etekcity/Vesync smart plug hacking
 \copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
 Licensed under the MIT License. Refer to LICENSE file in the project root. */
 /////////////////////////////////////////////////////////////////////////////
-#ifndef UNIT_TEST
 
 //- includes
 #include "smartplug.h"
+#include "hlw8012.h"
 #include "settings.h"
+#include "utils.h"
 #include <Arduino.h>
 
 namespace {
-    static volatile int pulsePin = SmartPlug::PIN_CF1;
-    static volatile int pulseStart = 0;
+    const uint32_t SECONDS_PER_DAY = 86400;
 }
 
 SmartPlug* SmartPlug::instance_ = nullptr;
@@ -22,12 +22,22 @@ SmartPlug* SmartPlug::instance_ = nullptr;
 /////////////////////////////////////////////////////////////////////////////
 SmartPlug::SmartPlug(Settings& settings)
 : settings_(settings)
+, propSysMeterOverflows_{ &settings.propSysMeter(), "overflows" }
+, propSysMeterCf_{ &settings.propSysMeter(), "cf" }
+, propSysMeterCf1_{ &settings.propSysMeter(), "cf1" }
+, propSysMeterTrace_{ &settings.propSysMeter(), "trace" }
+, propSysMeterTraceRequested_{ &propSysMeterTrace_, "requested" }
+, propSysMeterTraceCount_{ &propSysMeterTrace_, "count" }
+, propEnergy_{ &settings.propRoot(), "energy" }
+, propEnergyTotal_{ &propEnergy_, "total", 0 }
+, propEnergyToday_{ &propEnergy_, "today", 0 }
 {
     assert(!instance_);
     instance_ = this;
 }
 SmartPlug::~SmartPlug() {
-    detachInterrupt(pulsePin);
+    detachInterrupt(PIN_CF);
+    detachInterrupt(PIN_CF1);
     instance_ = nullptr;
 }
 
@@ -38,8 +48,6 @@ void SmartPlug::begin() {
 
     pinMode(PIN_CF,  INPUT);
     pinMode(PIN_CF1, INPUT);
-    pulsePin = PIN_CF1;
-    attachInterrupt(pulsePin, onRisingInterrupt_, RISING);
 
     pinMode(PIN_BLUE_LED, OUTPUT);
     pinMode(PIN_MOD_LED, OUTPUT);
@@ -51,89 +59,244 @@ void SmartPlug::begin() {
         setRelay(state);
     });
 
+    settings_.onMeter([this]() {
+        applyMode_();
+    });
+    applyMode_();
+
+    settings_.onProtect([this]() {
+        applyProtect_();
+    });
+
+    settings_.onTrace([this](unsigned count) {
+        return startTrace(count);
+    });
+
     lastMillis_ = millis();
 }
 
 /////////////////////////////////////////////////////////////////////////////
 void SmartPlug::tick() {
+    // record overpower trips (relay already opened by our ISR)
+    // Settings latches the fault, so we can rearm straight away
+    if (overpower_.tripped()) {
+        const auto milliWatts = overpower_.tripMilliWatts();
+        noInterrupts();
+        overpower_.clear();
+        interrupts();
+        settings_.tripProtect(milliWatts / 1000.0f);
+    }
+
+    // process edges captured by our ISRs
+    PulseEdge edge;
+    while (edges_.pop(edge)) {
+        trace_.add(edge.cycles, edge.pin, edge.rising);
+        processEdge_(edge);
+    }
+    if (trace_.capturing()) {
+        trace_.setOverflows(edgesOverflow_ - traceOverflows_);
+    }
+
+    // lower counted readings when pulses are overdue
+    // (also keeps clock_ within range of CCOUNT wrapping)
+    const auto nowCycles = clock_.extend(ESP.getCycleCount());
+    if (channelCf_.idle(nowCycles)) {
+        measMilliWatts_ = channelCf_.value();
+        measDirty_ = true;
+    }
+    if (channelCf1_.idle(nowCycles)) {
+        measMilliVolts_ = channelCf1_.value();
+    }
+
+    // publish steps promptly, backing off while steady
     const auto now = millis();
+    if (measDirty_) {
+        measDirty_ = false;
+        cadence_.measured(measMilliWatts_);
+        settings_.updateMeasurements(measMilliWatts_ / 1000.0, measMilliVolts_ / 1000.0, false);
+    }
+    if (cadence_.due(now)) {
+        settings_.updateMeasurements(measMilliWatts_ / 1000.0, measMilliVolts_ / 1000.0);
+    }
+
     if ((now - lastMillis_) < 1000) return;
     lastMillis_ = now;
 
-    if (measDirty_) {
-        measDirty_ = false;
+    // energy (UTC days)
+    const auto t = utils::unixTime();
+    if (t) energy_.setDay(t / SECONDS_PER_DAY);
+    propEnergyTotal_.set(energy_.totalWh());
+    propEnergyToday_.set(energy_.todayWh());
+    if (energy_.saveDue(now)) saveEnergy();
 
-        noInterrupts();
-        const auto watts = measPower_;
-        const auto volts = measVoltage_;
-        interrupts();
+    // occasional diagnostics (unchanged values aren't notified)
+    propSysMeterOverflows_.set(edgesOverflow_);
+    propSysMeterTraceCount_.set(trace_.count());
 
-        settings_.updateMeasurements(watts, volts);
-    }
+    // channel diagnostics change continually (edges), so are published at a
+    // low rate rather than notifying clients every second
+    if ((now - lastMillisDiagnostics_) < DIAGNOSTICS_MILLIS) return;
+    lastMillisDiagnostics_ = now;
+    propSysMeterCf_.update(channelCf_);
+    propSysMeterCf1_.update(channelCf1_);
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// switch relay
+/// Settings::setRelay() should be preferred, which won't close the relay
+/// while an overpower fault is latched
 void SmartPlug::setRelay(bool state) {
     relay_ = state;
     digitalWrite(PIN_RELAY, state);
 }
 
 /////////////////////////////////////////////////////////////////////////////
-IRAM_ATTR void SmartPlug::onRisingInterrupt_() {
-    pulseStart = micros();
-    attachInterrupt(pulsePin, onFallingInterrupt_, FALLING);
+/// load energy from JSON stream
+void SmartPlug::loadEnergy(Stream& stream) {
+    StaticJsonDocument<256> doc;
+    if (deserializeJson(doc, stream)) return;
+
+    energy_.restore(doc["total"].as<double>(), doc["today"].as<double>(), doc["day"].as<uint32_t>());
+    energy_.saved(millis());
 }
-IRAM_ATTR void SmartPlug::onFallingInterrupt_() {
-    const auto pulseWidth = micros() - pulseStart;
-    detachInterrupt(pulsePin);
-    if (pulseWidth <= 0) return;
 
-//    const int PWM_PERIOD = 1000000; // 1 hz
-//    if (pulse_width > PWM_PERIOD) return;
+/////////////////////////////////////////////////////////////////////////////
+/// save energy (also prior to rebooting)
+/// energy is kept apart from the settings, so it isn't written each time
+/// a persisted setting changes (nor the settings each time energy is saved)
+void SmartPlug::saveEnergy() {
+    if (!onPersistEnergy_) return;
+
+    StaticJsonDocument<256> doc;
+    doc["total"] = energy_.totalWh();
+    doc["today"] = energy_.todayWh();
+    doc["day"] = energy_.day();
+    onPersistEnergy_(doc);
 
-    // fcf  = v1 * v2 * 48 / v2ref * fosc / 128
-    // fcf1 = v1 * 24 / vref * fosc / 512
+    energy_.saved(millis());
+}
 
-    // https://tech.scargill.net/pow-th16-and-dual/
-    // V1 is the differential voltage between measurement pins V1P - V1N (+/-43.75mV peak)
-    // V2 is the differential voltage between measurement pins V2P and GND (+/-700mV peak)
-    // fosc is 3.579 MHz -+/-15 %)
-    // Vref is 2.43 V
+/////////////////////////////////////////////////////////////////////////////
+/// start capturing count raw edges (discards any previous trace)
+/// edges are recorded as tick() takes them from the ISRs' ring
+/// @returns false if count is invalid
+bool SmartPlug::startTrace(unsigned count) {
+    const auto mode = static_cast<uint8_t>(channelCf_.mode());
+    if (!trace_.start(count, channelCf_.ticksPerMicro(), mode)) return false;
+
+    traceOverflows_ = edgesOverflow_;
+    propSysMeterTraceRequested_.set(count);
+    propSysMeterTraceCount_.set(0);
+    printf("Capturing %u edges...\r\n", count);
+    return true;
+}
 
-    const auto FOSC = 3579000.0;
-    const auto VREF = 2.43;
+/////////////////////////////////////////////////////////////////////////////
+/// apply measurement mode and publishing intervals from settings
+///
+/// CF and CF1 are captured concurrently, each with their own interrupt
+/// which remains attached until the mode changes
+///
+/// WIDTH captures both edges to time each pulse
+/// COUNT only needs falling edges
+void SmartPlug::applyMode_() {
+    const auto mode = (settings_.meterMode() == "count")
+        ? PulseChannel::Mode::COUNT
+        : PulseChannel::Mode::WIDTH;
 
-    const auto ONE_MICROS = 1000000; // 1 microsecond
-    const auto freq = ONE_MICROS / (2.0 * pulseWidth);
+    cadence_.setIntervals(settings_.meterIntervalMin(), settings_.meterIntervalMax());
 
-    const auto V1_R = 0.002;
-    const auto V2_R1 = 2 * 953000.0;
-    const auto V2_R2 = 1000.0;
-    const auto V2_RDIV = V2_R2 / (V2_R1 + V2_R2);
+    detachInterrupt(PIN_CF);
+    detachInterrupt(PIN_CF1);
+    edges_.clear();
 
-    if (PIN_CF1 == pulsePin) {
-        pulsePin = PIN_CF;
+    const auto ticksPerMicro = ESP.getCpuFreqMHz();
+    clock_.reset(ESP.getCycleCount());
 
-        // Voltage RMS calculation formula
-        // fcfu = (v2 * 2) / vref * fosc / 512
-        const auto v2 = freq * 512 / FOSC * VREF / 2.0;
-        const auto vin = v2 / V2_RDIV;
-        instance_->measVoltage_ = vin;
+    channelCf_.setMode(mode);
+    channelCf_.setTicksPerMicro(ticksPerMicro);
+    channelCf1_.setMode(mode);
+    channelCf1_.setTicksPerMicro(ticksPerMicro);
 
-        // printf("CF pulseWidth: %d, voltage: %f\r\n", pulseWidth, vin);
+    applyProtect_();
 
+    if (PulseChannel::Mode::COUNT == mode) {
+        attachInterrupt(PIN_CF,  onCfFallingInterrupt_,  FALLING);
+        attachInterrupt(PIN_CF1, onCf1FallingInterrupt_, FALLING);
     } else {
-        pulsePin = PIN_CF1;
+        attachInterrupt(PIN_CF,  onCfChangeInterrupt_,  CHANGE);
+        attachInterrupt(PIN_CF1, onCf1ChangeInterrupt_, CHANGE);
+    }
+}
 
-        // fcf = (v1 * v2 * 48) / vref^2 * fosc / 128
-        const auto v1v2 = freq * 128 / FOSC * (VREF * VREF) / 48.0;
-        const auto power = v1v2 / V2_RDIV / V1_R;
-        instance_->measPower_ = power;
-        instance_->measDirty_ = true;
+/////////////////////////////////////////////////////////////////////////////
+/// apply overpower protection from settings
+void SmartPlug::applyProtect_() {
+    const auto limitMilliWatts = static_cast<uint32_t>(settings_.protectLimit() * 1000);
 
-        // printf("CF1 pulseWidth: %d, v1v2: %f, power: power\r\n", pulseWidth, v1v2, power);
+    noInterrupts();
+    overpower_.configure(limitMilliWatts, settings_.protectInrush(), ESP.getCpuFreqMHz());
+    interrupts();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// convert a captured edge into measurements
+void SmartPlug::processEdge_(const PulseEdge& edge) {
+    const auto cycles = clock_.extend(edge.cycles);
+    if (PIN_CF1 == edge.pin) {
+        if (!channelCf1_.edge(cycles, edge.rising)) return;
+        measMilliVolts_ = channelCf1_.value();
+        // printf("CF1 voltage: %u mV\r\n", measMilliVolts_);
+    } else {
+        // each accepted CF pulse is a quantum of energy (glitches aren't)
+        const auto accepted = channelCf_.accepted();
+        const bool measured = channelCf_.edge(cycles, edge.rising);
+        energy_.addPulses(channelCf_.accepted() - accepted);
+
+        if (!measured) return;
+        measMilliWatts_ = channelCf_.value();
+        measDirty_ = true;
+        // printf("CF power: %u mW\r\n", measMilliWatts_);
     }
+}
 
-    attachInterrupt(pulsePin, onRisingInterrupt_, RISING);
+/////////////////////////////////////////////////////////////////////////////
+/// publish channel diagnostics, beginning a new jitter window
+void SmartPlug::ChannelProperties::update(PulseChannel& channel) {
+    edges.set(channel.edges());
+    rejected.set(channel.rejected());
+    jitterMax.set(float(channel.jitterMax()) / channel.ticksPerMicro());
+    channel.resetJitter();
 }
 
-#endif // UNIT_TEST
+/////////////////////////////////////////////////////////////////////////////
+/// ISRs only capture edges, conversions occur within tick()
+/// ESP.getCycleCount() is an inlined read of CCOUNT, cheaper than micros()
+inline __attribute__((always_inline)) void SmartPlug::pushEdge_(uint32_t cycles, uint8_t pin, bool rising) {
+    if (!instance_->edges_.push(PulseEdge{ cycles, pin, rising })) {
+        instance_->edgesOverflow_ = instance_->edgesOverflow_ + 1;
+    }
+}
+/// open the relay directly on overpower, no waiting on tick()
+inline __attribute__((always_inline)) void SmartPlug::protectEdge_(uint32_t cycles) {
+    if (instance_->overpower_.edge(cycles)) {
+        GPOC = (1 << PIN_RELAY);
+    }
+}
+IRAM_ATTR void SmartPlug::onCfChangeInterrupt_() {
+    const auto cycles = ESP.getCycleCount();
+    const bool rising = 0 != GPIP(PIN_CF);
+    if (!rising) protectEdge_(cycles);
+    pushEdge_(cycles, PIN_CF, rising);
+}
+IRAM_ATTR void SmartPlug::onCf1ChangeInterrupt_() {
+    pushEdge_(ESP.getCycleCount(), PIN_CF1, 0 != GPIP(PIN_CF1));
+}
+IRAM_ATTR void SmartPlug::onCfFallingInterrupt_() {
+    const auto cycles = ESP.getCycleCount();
+    protectEdge_(cycles);
+    pushEdge_(cycles, PIN_CF, false);
+}
+IRAM_ATTR void SmartPlug::onCf1FallingInterrupt_() {
+    pushEdge_(ESP.getCycleCount(), PIN_CF1, false);
+}
@@ -9,15 +9,31 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 #define INCLUDED__SMARTPLUG
 
 //- includes
+#include "cadence.h"
+#include "cycle_clock.h"
+#include "energy.h"
+#include "hlw8012.h"
+#include "overpower.h"
+#include "property.h"
+#include "pulse_channel.h"
+#include "pulse_trace.h"
+#include "ring_buffer.h"
 #include <cassert>
+#include <cstdint>
+#include <functional>
 
 //- forwards
 class Settings;
+class Stream;
 
 /////////////////////////////////////////////////////////////////////////////
 /// smart plug
 class SmartPlug {
 public:
+    enum : uint32_t {
+        DIAGNOSTICS_MILLIS = 60000,     ///< sys.meter diagnostics window/publish period
+    };
+
     enum Pins {
         PIN_MOD_LED   = 2,  ///< ESP8266 module LED
         PIN_RELAY     = 4,  ///< relay (also lights LED yellow)
@@ -27,6 +43,9 @@ public:
         PIN_SW1       = 14, ///< button
     };
 
+    /// callback to persist energy
+    using FuncOnPersistEnergy = std::function<void (const JsonDocument&)>;
+
     explicit SmartPlug(Settings& settings);
     ~SmartPlug();
 
@@ -36,18 +55,89 @@ public:
     bool relay() const { return relay_; }
     void setRelay(bool state);
 
+    /////////////////////////////////////////////////////////////////////////
+    /// persist energy
+    void onPersistEnergy(FuncOnPersistEnergy onPersistEnergy) {
+        onPersistEnergy_ = std::move(onPersistEnergy);
+    }
+    void loadEnergy(Stream& stream);
+    void saveEnergy();
+
+    /////////////////////////////////////////////////////////////////////////
+    /// raw pulse trace
+    const PulseTrace& trace() const { return trace_; }
+    bool startTrace(unsigned count);
+
 private:
-    static void onRisingInterrupt_();
-    static void onFallingInterrupt_();
+    /// HLW8012 edge captured by our ISRs
+    struct PulseEdge {
+        uint32_t    cycles;             ///< CPU cycle count (CCOUNT) at time of edge
+        uint8_t     pin;                ///< pin the edge occurred on
+        bool        rising;             ///< rising (true) or falling (false) edge
+    };
+    /// captured edges awaiting processing
+    /// GPIO interrupts are dispatched from a single handler, so both
+    /// channels' ISRs are the ring's one producer
+    using PulseEdges = RingBufferT<PulseEdge, 128>;
+
+    /// channel diagnostics (sys.meter.cf / sys.meter.cf1)
+    struct ChannelProperties {
+        ChannelProperties(PropertyNode* parent, const char* name)
+        : node{ parent, name }
+        , edges{ &node, "edges" }
+        , rejected{ &node, "rejected" }
+        , jitterMax{ &node, "jitterMax" }
+        { }
+
+        void update(PulseChannel& channel);
+
+        PropertyNode    node;
+        PropertyUInt    edges;          ///< processed edges
+        PropertyUInt    rejected;       ///< rejected (implausible) periods
+        PropertyFloat   jitterMax;      ///< maximum edge interval jitter over the last window (us)
+    };
+
+    static void onCfChangeInterrupt_();
+    static void onCf1ChangeInterrupt_();
+    static void onCfFallingInterrupt_();
+    static void onCf1FallingInterrupt_();
+    static void pushEdge_(uint32_t cycles, uint8_t pin, bool rising);
+    static void protectEdge_(uint32_t cycles);
+
+    void applyMode_();
+    void applyProtect_();
+    void processEdge_(const PulseEdge& edge);
 
     static SmartPlug* instance_;
 
-    volatile double measPower_ = 0;     ///< measured power (W)
-    volatile double measVoltage_ = 0;   ///< measured mains voltage (V)
-    volatile bool   measDirty_ = false; ///< valid measurements
+    PulseEdges      edges_;             ///< edges pushed from our ISRs (both channels)
+    volatile uint32_t edgesOverflow_{0}; ///< edges dropped by our ISRs (ring full)
+    CycleClock      clock_;             ///< extends edge cycle counts
+    Overpower       overpower_;         ///< opens the relay from the CF ISR
+    PulseTrace      trace_;             ///< raw edge capture
+    uint32_t        traceOverflows_{0}; ///< edgesOverflow_ at start of capture
+    PulseChannel    channelCf_{ hlw8012::milliWattsFromFrequency };  ///< CF (power)
+    PulseChannel    channelCf1_{ hlw8012::milliVoltsFromFrequency }; ///< CF1 (voltage)
+
+    uint32_t        measMilliWatts_{0}; ///< measured power (mW)
+    uint32_t        measMilliVolts_{0}; ///< measured mains voltage (mV)
+    bool            measDirty_ = false; ///< valid measurements
+    Cadence         cadence_;           ///< measurement publishing cadence
+    Energy          energy_;            ///< energy accumulated from CF pulses
+    FuncOnPersistEnergy onPersistEnergy_; ///< on persist energy
 
     Settings&       settings_;          ///< settings access
-    unsigned long   lastMillis_{0};     ///< last value update
+    PropertyUInt    propSysMeterOverflows_;
+    ChannelProperties propSysMeterCf_;
+    ChannelProperties propSysMeterCf1_;
+    PropertyNode    propSysMeterTrace_;
+    PropertyUInt    propSysMeterTraceRequested_;
+    PropertyUInt    propSysMeterTraceCount_;
+    PropertyNode    propEnergy_;
+    PropertyFloat   propEnergyTotal_;
+    PropertyFloat   propEnergyToday_;
+    unsigned long   lastMillis_{0};     ///< last energy update
+    unsigned long   lastMillisDiagnostics_{0}; ///< last sys.meter diagnostics update
     bool            relay_ = false;     ///< current relay state
 };
 
@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+SPIFFS file backed FlashLog storage
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef UNIT_TEST
+
+//- includes
+#include "spiffs_log_storage.h"
+#include <FS.h>
+
+namespace {
+    /// fill size bytes with 0xFF from the file's current position
+    bool fillErased(File& file, uint32_t size) {
+        uint8_t erased[256];
+        memset(erased, 0xFF, sizeof(erased));
+        for (uint32_t ofs = 0; ofs < size; ofs += sizeof(erased)) {
+            if (file.write(erased, sizeof(erased)) != sizeof(erased)) return false;
+        }
+        return true;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+SpiffsLogStorage::SpiffsLogStorage(const char* path, uint32_t sectors)
+: path_(path)
+, sectors_(sectors)
+{ }
+
+/////////////////////////////////////////////////////////////////////////////
+/// allocate and open file (SPIFFS must be mounted)
+bool SpiffsLogStorage::begin() {
+    const auto size = sectors_ * SECTOR_SIZE;
+
+    file_ = SPIFFS.open(path_, "r+");
+    if (file_ && file_.size() == size) return true;
+
+    printf("Allocating %s...\r\n", path_);
+    file_ = SPIFFS.open(path_, "w+");
+    if (file_ && fillErased(file_, size)) {
+        file_.flush();
+        return true;
+    }
+    file_ = File{};
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// erase sector
+bool SpiffsLogStorage::erase(uint32_t sector) {
+    if (sector >= sectors_ || !seek_(sector, 0)) return false;
+    if (!fillErased(file_, SECTOR_SIZE)) return false;
+    file_.flush();
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// read from within a sector
+bool SpiffsLogStorage::read(uint32_t sector, uint32_t offset, void* data, uint32_t size) const {
+    if (sector >= sectors_ || offset + size > SECTOR_SIZE || !seek_(sector, offset)) return false;
+    return file_.read(static_cast<uint8_t*>(data), size) == size;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// write to within a sector
+/// only erased bytes are written by FlashLog, so a plain overwrite matches NOR behaviour
+bool SpiffsLogStorage::write(uint32_t sector, uint32_t offset, const void* data, uint32_t size) {
+    if (sector >= sectors_ || offset + size > SECTOR_SIZE || !seek_(sector, offset)) return false;
+    if (file_.write(static_cast<const uint8_t*>(data), size) != size) return false;
+    file_.flush(); // survive power loss
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// position the open file within a sector
+bool SpiffsLogStorage::seek_(uint32_t sector, uint32_t offset) const {
+    return file_ && file_.seek(sector * SECTOR_SIZE + offset, SeekSet);
+}
+
+#endif // UNIT_TEST
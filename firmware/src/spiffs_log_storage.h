@@ -0,0 +1,42 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+SPIFFS file backed FlashLog storage
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__SPIFFS_LOG_STORAGE
+#define INCLUDED__SPIFFS_LOG_STORAGE
+
+//- includes
+#include "flash_log.h"
+#include <FS.h>
+
+/////////////////////////////////////////////////////////////////////////////
+/// FlashLog sectors held in a preallocated SPIFFS file
+///
+/// The flash layout has no spare region outside of the sketch, OTA and
+/// SPIFFS areas, so the log occupies a fixed size file instead. Sectors
+/// are 4 KB file offsets, SPIFFS remaps the pages beneath them, so an erase
+/// is a 4 KB write of 0xFF rather than a flash sector erase. The file is
+/// held open, rather than opened for every access.
+class SpiffsLogStorage : public FlashLogStorage {
+public:
+    SpiffsLogStorage(const char* path, uint32_t sectors);
+
+    bool begin();
+
+    uint32_t sectors() const override { return sectors_; }
+    bool erase(uint32_t sector) override;
+    bool read(uint32_t sector, uint32_t offset, void* data, uint32_t size) const override;
+    bool write(uint32_t sector, uint32_t offset, const void* data, uint32_t size) override;
+
+private:
+    bool seek_(uint32_t sector, uint32_t offset) const;
+
+    const char*     path_;          ///< file path
+    uint32_t        sectors_;       ///< number of sectors
+    mutable File    file_;          ///< open file (once allocated)
+};
+
+#endif // INCLUDED__SPIFFS_LOG_STORAGE
@@ -0,0 +1,48 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Windowed power and voltage statistics
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "stats_window.h"
+
+constexpr PropertyField StatsWindow::AggregateSchema::FIELDS[];
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor
+StatsWindow::StatsWindow(PropertyNode* parent, const char* name, unsigned seconds)
+: propNode_{ parent, name }
+, propSeconds_{ &propNode_, "seconds", seconds, Property::PERSIST }
+, propPower_{ &propNode_, "power" }
+, propVoltage_{ &propNode_, "voltage" }
+{ }
+
+/////////////////////////////////////////////////////////////////////////////
+/// add a 1 s sample, publishing as the window closes
+void StatsWindow::add(float watts, float volts) {
+    power_.add(watts);
+    voltage_.add(volts);
+    if (power_.count() < seconds()) return;
+
+    publish_(propPower_, power_);
+    publish_(propVoltage_, voltage_);
+    power_.reset();
+    voltage_.reset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// change window length, restarting the current window
+void StatsWindow::setSeconds(unsigned seconds) {
+    propSeconds_.set(seconds);
+    power_.reset();
+    voltage_.reset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// publish window statistics
+void StatsWindow::publish_(Aggregate& aggregate, const RunningStats& stats) {
+    aggregate.set({ float(stats.min()), float(stats.max()), float(stats.mean()), float(stats.stddev()) });
+}
@@ -0,0 +1,65 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Windowed power and voltage statistics
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__STATS_WINDOW
+#define INCLUDED__STATS_WINDOW
+
+//- includes
+#include "property.h"
+#include "property_record.h"
+#include "running_stats.h"
+
+/////////////////////////////////////////////////////////////////////////////
+/// min/max/mean/stddev of power and voltage over a tumbling window
+///
+/// Values are only published as each window closes, so subscribers see a
+/// summary per window rather than every sample (without missing peaks).
+class StatsWindow {
+public:
+    enum : unsigned {
+        SECONDS_MAX = 86400,    ///< longest window
+    };
+
+    StatsWindow(PropertyNode* parent, const char* name, unsigned seconds);
+
+    void add(float watts, float volts);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// window length (seconds)
+    unsigned seconds() const { return propSeconds_.value(); }
+    void setSeconds(unsigned seconds);
+
+private:
+    /// published statistics (a record, there are several of them in RAM)
+    struct AggregateSchema {
+        struct Values {
+            float   min;
+            float   max;
+            float   mean;
+            float   stddev;
+        };
+        static constexpr PropertyField FIELDS[] = {
+            PROPERTY_FIELD(Values, min, 0),
+            PROPERTY_FIELD(Values, max, 0),
+            PROPERTY_FIELD(Values, mean, 0),
+            PROPERTY_FIELD(Values, stddev, 0),
+        };
+    };
+    using Aggregate = PropertyRecordT<AggregateSchema>;
+
+    static void publish_(Aggregate& aggregate, const RunningStats& stats);
+
+    PropertyNode    propNode_;
+    PropertyUInt    propSeconds_;
+    Aggregate       propPower_;
+    Aggregate       propVoltage_;
+
+    RunningStats    power_;             ///< power within current window
+    RunningStats    voltage_;           ///< voltage within current window
+};
+
+#endif // INCLUDED__STATS_WINDOW
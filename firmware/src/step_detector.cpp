@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Load step (event) detection
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "step_detector.h"
+#include <algorithm>
+
+/////////////////////////////////////////////////////////////////////////////
+/// add (1 s) power sample
+/// @param now UNIX time of the sample (0 if unknown)
+/// @returns true if a step was logged
+bool StepDetector::add(float watts, uint32_t now) {
+    if (0 == levelSamples_) {
+        level_ = watts;
+        levelSamples_ = 1;
+        return false;
+    }
+
+    // smallest step of interest, half of which is allowed as noise
+    const auto step = std::max(float(STEP_MIN_WATTS), level_ * STEP_PERCENT / 100.0f);
+    const auto threshold = step * THRESHOLD;
+
+    accumulate_(up_, watts - level_ - step / 2, watts, level_);
+    accumulate_(down_, level_ - watts - step / 2, watts, level_);
+
+    if (up_.sum > threshold && up_.samples >= MIN_SAMPLES) {
+        step_(up_, now);
+        return true;
+    }
+    if (down_.sum > threshold && down_.samples >= MIN_SAMPLES) {
+        step_(down_, now);
+        return true;
+    }
+
+    // follow the level (and any slow drift)
+    ++levelSamples_;
+    const auto n = std::min(levelSamples_, uint32_t{LEVEL_SAMPLES});
+    level_ += (watts - level_) / n;
+    return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// accumulate a departure from the level, restarting the run once it returns
+void StepDetector::accumulate_(Run& run, float departure, float watts, float level) {
+    run.sum = std::max(0.0f, run.sum + departure);
+    if (0 == run.sum) {
+        run = Run{};
+        return;
+    }
+
+    if (0 == run.samples) {
+        run.level = level;
+        run.first = watts;
+    }
+    run.watts += watts;
+    ++run.samples;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// log a step at the start of run, which becomes the new level
+void StepDetector::step_(const Run& run, uint32_t now) {
+    // the first sample likely straddles the step
+    const auto after = (run.samples > 1)
+        ? (run.watts - run.first) / (run.samples - 1)
+        : run.watts;
+
+    auto& event = events_[end_ % EVENTS];
+    event.time = (0 != now) ? now - (run.samples - 1) : 0;
+    event.duration = (levelSamples_ + 1) - run.samples;
+    event.before = run.level;
+    event.after = after;
+    ++end_;
+
+    level_ = after;
+    levelSamples_ = run.samples;
+    up_ = Run{};
+    down_ = Run{};
+}
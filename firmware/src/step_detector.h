@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Load step (event) detection
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__STEP_DETECTOR
+#define INCLUDED__STEP_DETECTOR
+
+//- includes
+#include <cstddef>
+#include <cstdint>
+
+/////////////////////////////////////////////////////////////////////////////
+/// detects steps in power (loads switching on/off) from 1 s samples
+///
+/// A two-sided CUSUM tracks samples departing from the current level by
+/// more than half the smallest step of interest. Once either sum exceeds
+/// the threshold, a step is logged as starting at the first sample of that
+/// run, so noise and slow drift pass without an event while a clean step
+/// is picked up within a few seconds.
+///
+/// Steps are held in a ring, numbered sequentially from boot (as History),
+/// so clients can fetch events they missed.
+class StepDetector {
+public:
+    enum : uint32_t {
+        EVENTS          = 32,   ///< events held
+        STEP_MIN_WATTS  = 5,    ///< smallest step of interest (W), half is allowed as noise
+        STEP_PERCENT    = 10,   ///< smallest step of interest relative to the level
+        THRESHOLD       = 2,    ///< CUSUM threshold (in smallest steps)
+        MIN_SAMPLES     = 2,    ///< samples into a step before it's reported
+        LEVEL_SAMPLES   = 60,   ///< samples averaged into the level (tracks drift)
+    };
+
+    /// power step
+    struct Event {
+        uint32_t    time;       ///< UNIX time of the step (0 if the clock wasn't set)
+        uint32_t    duration;   ///< seconds the previous level was held
+        float       before;     ///< level before the step (W)
+        float       after;      ///< level after the step (W)
+    };
+
+    StepDetector() = default;
+
+    StepDetector(const StepDetector&) = delete;
+    StepDetector& operator=(const StepDetector&) = delete;
+
+    bool add(float watts, uint32_t now);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// current level (W)
+    float level() const { return level_; }
+
+    /// oldest event held
+    uint32_t begin() const { return (end_ > EVENTS) ? end_ - EVENTS : 0; }
+    /// sequence number following the newest event
+    uint32_t end() const { return end_; }
+    /// event by sequence number (must be within begin() .. end())
+    const Event& at(uint32_t seq) const { return events_[seq % EVENTS]; }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// up to count events from start, calling func(seq, event)
+    template <typename Func>
+    void read(uint32_t start, uint32_t count, Func func) const {
+        if (start < begin()) start = begin();
+        for (auto seq = start; seq < end_ && seq - start < count; ++seq) {
+            func(seq, at(seq));
+        }
+    }
+
+private:
+    /// one side of the CUSUM (departures up or down)
+    struct Run {
+        float       sum;        ///< cumulative departure beyond the allowance
+        float       level;      ///< level as the run began (W)
+        float       watts;      ///< sum of samples in the run
+        float       first;      ///< first sample (may straddle the step)
+        uint32_t    samples;    ///< samples in the run
+    };
+
+    static void accumulate_(Run& run, float departure, float watts, float level);
+    void step_(const Run& run, uint32_t now);
+
+    Event       events_[EVENTS];    ///< ring of events
+    uint32_t    end_{0};            ///< next sequence number
+
+    float       level_{0};          ///< current level (W)
+    uint32_t    levelSamples_{0};   ///< samples since the level began
+    Run         up_{};              ///< rising run
+    Run         down_{};            ///< falling run
+};
+
+#endif // INCLUDED__STEP_DETECTOR
@@ -9,6 +9,7 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 //- includes
 #include "utils.h"
 #include <IPAddress.h>
+#include <time.h>
 
 using namespace utils;
 
@@ -35,3 +36,12 @@ bool utils::validSubnet(const IPAddress& subnet) {
     // http://www.graphics.stanford.edu/~seander/bithacks.html#DetermineIfPowerOf2
     return (s && !(s & (s - 1)));
 }
+
+/////////////////////////////////////////////////////////////////////////////
+/// current UNIX time
+/// @returns 0 if the time is yet to be synchronized
+uint32_t utils::unixTime() {
+    const time_t TIME_VALID = 1514764800; // 2018-01-01
+    const auto now = time(nullptr);
+    return (now >= TIME_VALID) ? static_cast<uint32_t>(now) : 0;
+}
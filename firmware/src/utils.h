@@ -8,6 +8,9 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 #ifndef INCLUDED__UTILS
 #define INCLUDED__UTILS
 
+//- includes
+#include <cstdint>
+
 //- forwards
 class IPAddress;
 
@@ -15,6 +18,8 @@ namespace utils {
 
 bool validSubnet(const IPAddress& subnet);
 
+uint32_t unixTime();
+
 } // namespace utils
 
 #endif // INCLUDED__UTILS
@@ -9,11 +9,37 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 
 //- includes
 #include "web_server.h"
+#include "flash_log.h"
+#include "print_buffer.h"
+#include "pulse_trace.h"
 #include "settings.h"
 #include "ssdp.h"
 #include "web_server_asset_handler.h"
 #include "wifi_manager.h"
 #include <ArduinoJson.h>
+#include <algorithm>
+#include <memory>
+
+namespace {
+    /// print an update of the properties changed since a generation straight
+    /// into a WebSocket buffer (refcounted, so clients can share it)
+    /// @returns nullptr if the buffer couldn't be allocated
+    AsyncWebSocketMessageBuffer* makeUpdate(AsyncWebSocket& ws, PropertyNode& props, uint32_t since, bool msgPack) {
+        static const char PREFIX[] = R"({"jsonrpc":"2.0","method":"update","params":)";
+        auto* buffer = ws.makeBuffer(msgPack ? props.measureMsgPack(0, since) : strlen(PREFIX) + props.measureJson(0, since) + 1);
+        if (!buffer) return nullptr;
+
+        PrintBuffer out{buffer->get(), buffer->length()};
+        if (msgPack) {
+            props.printMsgPack(out, 0, since);
+        } else {
+            out.print(PREFIX);
+            props.printJson(out, 0, since);
+            out.print('}');
+        }
+        return buffer;
+    }
+}
 
 /////////////////////////////////////////////////////////////////////////////
 /// log web requests
@@ -43,7 +69,7 @@ WebServer::WebServer(Settings& settings)
 
 /////////////////////////////////////////////////////////////////////////////
 /// begin web server
-void WebServer::begin(WifiManager& wifi) {
+void WebServer::begin(WifiManager& wifi, FlashLog& log, const PulseTrace& trace) {
     // request logger
     server_.addHandler(new WebRequestLogger());
 
@@ -53,13 +79,42 @@ void WebServer::begin(WifiManager& wifi) {
             request->send(200, "text/plain", "pong");
         });
         server_.on("/api/v1/state", HTTP_GET, [this](AsyncWebServerRequest* request) {
-            auto* response = request->beginResponseStream("application/json");
-            if (response) {
-                DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
-                settings_.toJson(doc);
-                serializeJson(doc, *response);
-                request->send(response);
+            // the tree is printed afresh into each chunk, skipping what was already
+            // sent, so nothing is buffered beyond the chunk. A change between chunks
+            // would splice two states, so the response ends short instead (the
+            // client retries the invalid document)
+            uint32_t generation = 0;
+            auto* response = request->beginChunkedResponse("application/json", [this, generation](uint8_t* buffer, size_t maxLen, size_t index) mutable -> size_t {
+                const auto changed = settings_.propRoot().changed();
+                if (0 == index) generation = changed;
+                else if (changed != generation) return 0;
+
+                PrintBuffer out{buffer, maxLen, index};
+                settings_.printJson(out);
+                return out.length();
+            });
+            if (response) request->send(response);
+        });
+        server_.on("/api/v1/log", HTTP_GET, [&log](AsyncWebServerRequest* request) {
+            // stream per minute records (FlashLogRecord) from oldest to newest
+            std::shared_ptr<FlashLog::Reader> reader{ new FlashLog::Reader{log} };
+            auto* response = request->beginChunkedResponse("application/octet-stream", [reader](uint8_t* buffer, size_t maxLen, size_t /*index*/) {
+                return reader->read(buffer, maxLen);
+            });
+            if (response) request->send(response);
+        });
+        server_.on("/api/v1/trace", HTTP_GET, [&trace](AsyncWebServerRequest* request) {
+            // raw pulse trace blob (PulseTrace::Header + Records)
+            if (trace.capturing()) {
+                request->send(409, "text/plain", "Capture in progress");
+                return;
             }
+            // held until the response completes, so the length stays valid
+            std::shared_ptr<PulseTrace::Reader> reader{ new PulseTrace::Reader{trace} };
+            auto* response = request->beginResponse("application/octet-stream", reader->size(), [reader](uint8_t* buffer, size_t maxLen, size_t index) {
+                return reader->read(index, buffer, maxLen);
+            });
+            if (response) request->send(response);
         });
         server_.on("/api/v1/update", HTTP_POST, [this](AsyncWebServerRequest* request) {
             // HTTP update based on https://gist.github.com/JMishou/60cb762047b735685e8a09cd2eb42a60
@@ -164,18 +219,9 @@ void WebServer::begin(WifiManager& wifi) {
         request->send( (request->method() == HTTP_OPTIONS) ? 200 : 404 );
     });
 
-    // dirty property notifications
-    settings_.onDirtyProperties([this](const JsonDocument& docProps) {
-        DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
-        auto json = doc.to<JsonObject>();
-        json["jsonrpc"] = "2.0";
-        json["method"] = "update";
-        json["params"] = docProps;
-        auto* textBuffer = serverWebSocket_.makeBuffer(measureJson(json));
-        if (textBuffer) {
-            serializeJson(json, reinterpret_cast<char*>(textBuffer->get()), textBuffer->length() + 1);
-            serverWebSocket_.textAll(textBuffer);
-        }
+    // property change notifications
+    settings_.onChangedProperties([this](PropertyNode& props) {
+        onChangedProperties_(props);
     });
 
     // restart server on network changes
@@ -196,15 +242,52 @@ void WebServer::tick() {
     serverWebSocket_.cleanupClients();
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// property change notifications, in each client's chosen encoding
+/// clients keep their own cursor, so one with a full queue misses nothing,
+/// it takes a larger update once it drains
+void WebServer::onChangedProperties_(PropertyNode& props) {
+    const auto latest = Property::generation();
+
+    for (auto it = clients_.begin(); it != clients_.end(); ++it) {
+        const auto since = it->since;
+        const bool msgPack = it->msgPack;
+        const auto sameGroup = [=](const Client& c) { return c.since == since && c.msgPack == msgPack; };
+        if (props.changed() <= since) continue;
+        // an earlier client still at this cursor wasn't sent to, so its group was handled
+        // (sent clients moved on to latest, which is never behind props.changed())
+        if (std::any_of(clients_.begin(), it, sameGroup)) continue;
+
+        // clients at the same cursor (and encoding) share the update
+        auto* buffer = makeUpdate(serverWebSocket_, props, since, msgPack);
+        if (!buffer) continue; // retried next time
+        for (auto& c : clients_) {
+            if (!sameGroup(c)) continue;
+
+            auto* client = serverWebSocket_.client(c.id);
+            if (!client || client->queueIsFull()) continue;
+            if (msgPack) {
+                client->binary(buffer);
+            } else {
+                client->text(buffer);
+            }
+            c.since = latest;
+        }
+    }
+}
+
 /////////////////////////////////////////////////////////////////////////////
 /// web socket event
 void WebServer::onWebSocketEvent_(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len) {
     if (type == WS_EVT_CONNECT) {
         printf("ws[%s][%u] connect\r\n", server->url(), client->id());
+        clients_.push_back({ client->id(), false, Property::generation() }); // fetches state itself
         // client->printf("Hello Client %u :)", client->id());
         // client->ping();
     } else if (type == WS_EVT_DISCONNECT) {
         printf("ws[%s][%u] disconnect\r\n", server->url(), client->id());
+        const auto id = client->id();
+        clients_.erase(std::remove_if(clients_.begin(), clients_.end(), [id](const Client& c) { return c.id == id; }), clients_.end());
     } else if (type == WS_EVT_ERROR) {
         printf("ws[%s][%u] error(%u): %s\r\n", server->url(), client->id(), *((uint16_t*)arg), (char*)data);
     } else if (type == WS_EVT_PONG) {
@@ -270,33 +353,72 @@ void WebServer::onJsonRpc_(AsyncWebSocketClient* client, char* data, size_t len)
     const auto id = request["id"];
 
     // process request
-    {
-        DynamicJsonDocument resultDoc{Settings::JSON_STATE_SIZE};
-        const auto result = settings_.call(method, params, resultDoc);
-
-        // fill in response
-        DynamicJsonDocument responseDoc{Settings::JSON_STATE_SIZE};
-        auto response = responseDoc.to<JsonObject>();
-        response["jsonrpc"] = "2.0";
-        response["id"] = id;
+    // state is streamed straight from the property tree, other methods build a result document
+    // subscribe is per client, so handled here rather than by settings
+    const bool state = (0 == strcmp(method, "state"));
+    DynamicJsonDocument resultDoc{state ? 0 : Settings::JSON_STATE_SIZE};
+    auto result = JsonRpcError::NO_ERROR;
+    if (0 == strcmp(method, "subscribe")) {
+        result = subscribe_(client, params, resultDoc);
+    } else if (!state) {
+        result = settings_.call(method, params, resultDoc);
+    }
 
+    // print response around the result, measuring it first
+    auto printResponse = [&](Print& out) {
+        out.print(R"({"jsonrpc":"2.0","id":)");
+        serializeJson(id, out);
         if (JsonRpcError::NO_ERROR == result) {
-            response["result"] = resultDoc;
+            out.print(R"(,"result":)");
+            if (state) {
+                settings_.printJson(out);
+            } else {
+                serializeJson(resultDoc, out);
+            }
         } else {
-            auto error = response.createNestedObject("error");
-            error["code"] = static_cast<int>(result);
-            error["message"] = resultDoc;
+            out.print(R"(,"error":{"code":)");
+            out.print(static_cast<int>(result));
+            out.print(R"(,"message":)");
+            serializeJson(resultDoc, out);
+            out.print('}');
         }
+        out.print('}');
+    };
+
+    PrintLength length;
+    printResponse(length);
+
+    // send response
+    auto* buffer = serverWebSocket_.makeBuffer(length.length());
+    if (buffer) {
+        PrintBuffer out{buffer->get(), buffer->length()};
+        printResponse(out);
+        client->text(buffer);
+    }
+}
 
-        // serializeJson(response, Serial);
-
-        // send response
-        auto* buffer = serverWebSocket_.makeBuffer(measureJson(response));
-        if (buffer) {
-            serializeJson(response, reinterpret_cast<char*>(buffer->get()), buffer->length() + 1); // room for null terminator (buffer included this for us)
-            client->text(buffer);
-        }
+/////////////////////////////////////////////////////////////////////////////
+/// subscribe - choose the encoding of this client's update notifications
+/// params (all optional):
+///   encoding - "json" (default) or "msgpack"
+/// MessagePack updates are binary frames holding a map of leaf id (see the
+/// schema method) to value, starting with the full state
+JsonRpcError WebServer::subscribe_(AsyncWebSocketClient* client, const JsonVariant& params, JsonDocument& result) {
+    if (!params.isNull() && !params.is<JsonObject>()) { result.set("Expected object"); return JsonRpcError::INVALID_PARAMS; }
+
+    const char* encoding = params["encoding"] | "json";
+    const bool msgPack = (0 == strcmp(encoding, "msgpack"));
+    if (!msgPack && 0 != strcmp(encoding, "json")) { result.set("Invalid encoding"); return JsonRpcError::INVALID_PARAMS; }
+
+    // rewinding the cursor sends MessagePack clients the full state
+    for (auto& c : clients_) {
+        if (c.id != client->id()) continue;
+        c.msgPack = msgPack;
+        if (msgPack) c.since = 0;
     }
+
+    result.set(true);
+    return JsonRpcError::NO_ERROR;
 }
 
 #endif // UNIT_TEST
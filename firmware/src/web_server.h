@@ -11,10 +11,15 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 //- includes
 #include <ArduinoJson.h>
 #include <ESPAsyncWebServer.h>
+#include <vector>
 
 //- forwards
+class FlashLog;
+class PropertyNode;
+class PulseTrace;
 class Settings;
 class WifiManager;
+enum class JsonRpcError;
 
 /////////////////////////////////////////////////////////////////////////////
 /// web server
@@ -25,16 +30,26 @@ public:
     WebServer(const WebServer&) = delete;
     WebServer& operator=(const WebServer&) = delete;
 
-    void begin(WifiManager& wifi);
+    void begin(WifiManager& wifi, FlashLog& log, const PulseTrace& trace);
     void tick();
 
 private:
+    /// connected WebSocket client
+    struct Client {
+        uint32_t    id;         ///< client id
+        bool        msgPack;    ///< receives MessagePack updates (rather than JSON)
+        uint32_t    since;      ///< property generation the client is up to
+    };
+
+    void onChangedProperties_(PropertyNode& props);
     void onWebSocketEvent_(AsyncWebSocket* server, AsyncWebSocketClient* client, AwsEventType type, void* arg, uint8_t* data, size_t len);
     void onJsonRpc_(AsyncWebSocketClient* client, char* data, size_t len);
+    JsonRpcError subscribe_(AsyncWebSocketClient* client, const JsonVariant& params, JsonDocument& result);
 
     AsyncWebServer  server_{80};        ///< async web server
     AsyncWebSocket  serverWebSocket_;   ///< async web socket
     Settings&       settings_;          ///< settings access
+    std::vector<Client> clients_;       ///< connected WebSocket clients
     AsyncWebServerRequest* update_request_{nullptr};    ///< tracks update request
     int             last_update_percent_{-1};           ///< last reported percentage
 };
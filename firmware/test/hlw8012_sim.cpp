@@ -0,0 +1,212 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Host HLW8012 pulse simulator
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "hlw8012_sim.h"
+#include "hlw8012.h"
+#include <Arduino.h>
+#include <cassert>
+#include <limits>
+
+namespace {
+    /// simulated pin
+    struct Pin {
+        bool        level;              ///< current level
+        void        (*handler)();       ///< attached interrupt
+        int         mode;               ///< interrupt mode
+    };
+    const uint8_t PINS = 17;
+
+    /// starts just short of CCOUNT wrapping, so it's exercised early on
+    const uint64_t START_CYCLES = 0xF0000000;
+
+    Pin             pins[PINS];
+    uint64_t        nowCycles = START_CYCLES;
+    uint8_t         ticksPerMicro = 80;
+    Hlw8012Sim*     instance = nullptr;
+
+    /// drive an input pin, invoking its interrupt
+    void deliver(uint8_t pin, bool rising) {
+        assert(pin < PINS);
+        auto& p = pins[pin];
+        p.level = rising;
+        if (!p.handler) return;
+        if (   CHANGE == p.mode
+            || (RISING == p.mode && rising)
+            || (FALLING == p.mode && !rising)
+        ) {
+            p.handler();
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Arduino stand-ins
+/////////////////////////////////////////////////////////////////////////////
+extern "C" unsigned long millis() {
+    return static_cast<unsigned long>(nowCycles / (ticksPerMicro * 1000u));
+}
+extern "C" unsigned long micros() {
+    return static_cast<unsigned long>(nowCycles / ticksPerMicro);
+}
+
+void pinMode(uint8_t /*pin*/, uint8_t /*mode*/) { }
+void digitalWrite(uint8_t pin, uint8_t value) {
+    assert(pin < PINS);
+    pins[pin].level = (LOW != value);
+}
+int digitalRead(uint8_t pin) {
+    assert(pin < PINS);
+    return pins[pin].level ? HIGH : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode) {
+    assert(pin < PINS);
+    pins[pin].handler = handler;
+    pins[pin].mode = mode;
+}
+void detachInterrupt(uint8_t pin) {
+    assert(pin < PINS);
+    pins[pin].handler = nullptr;
+}
+
+uint32_t GPIP(uint8_t pin) {
+    return digitalRead(pin);
+}
+
+GpioClearRegister GPOC;
+GpioClearRegister& GpioClearRegister::operator=(uint32_t mask) {
+    for (uint8_t pin = 0; pin < PINS; ++pin) {
+        if (mask & (1u << pin)) pins[pin].level = false;
+    }
+    return *this;
+}
+
+EspClass ESP;
+uint32_t EspClass::getCycleCount() {
+    return static_cast<uint32_t>(nowCycles);
+}
+uint8_t EspClass::getCpuFreqMHz() {
+    return ticksPerMicro;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// constructor, resets simulated time and pins
+Hlw8012Sim::Hlw8012Sim(uint8_t cpuMHz)
+: cpuMHz_(cpuMHz)
+, cf_{ PIN_CF, hlw8012::WATTS_PER_HZ, 0, 0 }
+, cf1_{ PIN_CF1, hlw8012::VOLTS_PER_HZ, 0, 0 }
+{
+    assert(!instance);
+    instance = this;
+
+    memset(pins, 0, sizeof(pins));
+    nowCycles = START_CYCLES;
+    ticksPerMicro = cpuMHz;
+}
+Hlw8012Sim::~Hlw8012Sim() {
+    instance = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// simulated power (W) and voltage (V)
+void Hlw8012Sim::setPower(double watts) {
+    setValue_(cf_, watts);
+}
+void Hlw8012Sim::setVoltage(double volts) {
+    setValue_(cf1_, volts);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// simulate synthetic pulse trains for a period of time
+void Hlw8012Sim::run(uint32_t millis, const FuncTick& tick, uint32_t tickMicros) {
+    const double tickCycles = double(tickMicros) * cpuMHz_;
+    const double end = double(nowCycles) + double(millis) * 1000 * cpuMHz_;
+    double nextTick = double(nowCycles) + tickCycles;
+
+    for (;;) {
+        const auto cf = next_(cf_);
+        const auto cf1 = next_(cf1_);
+        if (nextTick <= cf && nextTick <= cf1) {
+            if (nextTick > end) break;
+            nowCycles = static_cast<uint64_t>(nextTick);
+            tick();
+            nextTick += tickCycles;
+        } else {
+            auto& train = (cf <= cf1) ? cf_ : cf1_;
+            if (next_(train) > end) break;
+            edge_(train);
+        }
+    }
+    nowCycles = static_cast<uint64_t>(end);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// replay recorded edges (in order, cycles relative to now)
+void Hlw8012Sim::replay(const Edges& edges, const FuncTick& tick, uint32_t tickMicros) {
+    const uint64_t tickCycles = uint64_t{tickMicros} * cpuMHz_;
+    const uint64_t start = nowCycles;
+    uint64_t nextTick = start + tickCycles;
+
+    for (const auto& edge : edges) {
+        const auto t = start + edge.cycles;
+        for (; nextTick <= t; nextTick += tickCycles) {
+            nowCycles = nextTick;
+            tick();
+        }
+        nowCycles = t;
+        deliver(edge.pin, edge.rising);
+        ++edges_;
+    }
+
+    nowCycles = nextTick;
+    tick();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// simulated CPU cycles
+uint64_t Hlw8012Sim::cycles() const {
+    return nowCycles;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// current pin level
+bool Hlw8012Sim::level(uint8_t pin) const {
+    return 0 != digitalRead(pin);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// change a pulse train's frequency (value / unitsPerHz)
+/// a running train continues from its last edge
+void Hlw8012Sim::setValue_(Train& train, double value) {
+    const auto hz = value / train.unitsPerHz;
+    if (hz <= 0) {
+        train.halfPeriod = 0;
+        return;
+    }
+
+    if (0 == train.halfPeriod) train.last = double(nowCycles);
+    train.halfPeriod = cpuMHz_ * 1e6 / (2 * hz);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// time of a train's next edge
+double Hlw8012Sim::next_(const Train& train) const {
+    return (train.halfPeriod > 0)
+        ? train.last + train.halfPeriod
+        : std::numeric_limits<double>::infinity();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// produce a train's next edge
+void Hlw8012Sim::edge_(Train& train) {
+    train.last = next_(train);
+    nowCycles = static_cast<uint64_t>(train.last);
+    deliver(train.pin, !pins[train.pin].level);
+    ++edges_;
+}
@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Host HLW8012 pulse simulator
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__TEST__HLW8012_SIM
+#define INCLUDED__TEST__HLW8012_SIM
+
+//- includes
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/////////////////////////////////////////////////////////////////////////////
+/// simulates HLW8012 CF/CF1 pulse trains on the host
+///
+/// Drives the Arduino stand-ins (test/sim/Arduino.h): edges toggle GPIO
+/// levels and invoke attached pin interrupts at their simulated CPU cycle
+/// count, interleaved with calls to tick() as simulated time passes.
+/// Only one simulator may exist at a time.
+class Hlw8012Sim {
+public:
+    enum : uint8_t {
+        PIN_CF1 = 12,   ///< HLW8012 CF1 pin (voltage)
+        PIN_CF  = 13,   ///< HLW8012 CF pin (active power)
+    };
+
+    /// edge on a pin
+    struct Edge {
+        uint64_t    cycles;     ///< CPU cycles (relative to start of replay)
+        uint8_t     pin;        ///< pin the edge occurs on
+        bool        rising;     ///< rising (true) or falling (false) edge
+    };
+    using Edges = std::vector<Edge>;
+
+    /// called as simulated time passes
+    using FuncTick = std::function<void ()>;
+
+    explicit Hlw8012Sim(uint8_t cpuMHz = 80);
+    ~Hlw8012Sim();
+
+    // noncopyable
+    Hlw8012Sim(const Hlw8012Sim&) = delete;
+    // nonassignable
+    Hlw8012Sim& operator=(const Hlw8012Sim&) = delete;
+
+    void setPower(double watts);
+    void setVoltage(double volts);
+
+    void run(uint32_t millis, const FuncTick& tick, uint32_t tickMicros = 1000);
+    void replay(const Edges& edges, const FuncTick& tick, uint32_t tickMicros = 1000);
+
+    /////////////////////////////////////////////////////////////////////////
+    /// simulated CPU cycles
+    uint64_t cycles() const;
+    /// edges simulated
+    uint64_t edges() const { return edges_; }
+    /// current pin level
+    bool level(uint8_t pin) const;
+
+private:
+    /// 50% duty cycle pulse train
+    struct Train {
+        uint8_t     pin;                ///< output pin
+        double      unitsPerHz;         ///< value => frequency
+        double      halfPeriod;         ///< cycles between edges (0 = stopped)
+        double      last;               ///< last edge (cycles)
+    };
+
+    void setValue_(Train& train, double value);
+    double next_(const Train& train) const;
+    void edge_(Train& train);
+
+    const uint8_t   cpuMHz_;            ///< simulated CPU frequency
+    Train           cf_;                ///< CF (power)
+    Train           cf1_;               ///< CF1 (voltage)
+    uint64_t        edges_{0};          ///< edges simulated
+};
+
+#endif // INCLUDED__TEST__HLW8012_SIM
@@ -0,0 +1,70 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Host stand-in for the ESP8266 Arduino core
+
+Just enough of the core for SmartPlug to run against Hlw8012Sim: time,
+GPIO, pin interrupts and the CPU cycle counter are all simulated.
+Only the test program's include path picks this up, so the real core
+sources built for the host still see the real Arduino.h.
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+#ifndef INCLUDED__TEST__SIM__ARDUINO
+#define INCLUDED__TEST__SIM__ARDUINO
+
+//- includes
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#define IRAM_ATTR
+
+// pin levels
+#define LOW             0x0
+#define HIGH            0x1
+
+// pin modes
+#define INPUT           0x00
+#define OUTPUT          0x01
+#define INPUT_PULLUP    0x02
+
+// interrupt modes
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+
+extern "C" unsigned long millis();
+extern "C" unsigned long micros();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t pin, void (*handler)(), int mode);
+void detachInterrupt(uint8_t pin);
+
+/// interrupts are only ever simulated from the main thread
+inline void noInterrupts() { }
+inline void interrupts() { }
+
+/////////////////////////////////////////////////////////////////////////////
+/// GPIO input register (GPI)
+uint32_t GPIP(uint8_t pin);
+
+/// GPIO output clear register (GPOC), writing a mask drives those pins low
+struct GpioClearRegister {
+    GpioClearRegister& operator=(uint32_t mask);
+};
+extern GpioClearRegister GPOC;
+
+/////////////////////////////////////////////////////////////////////////////
+/// ESP8266 specifics
+class EspClass {
+public:
+    uint32_t getCycleCount();
+    uint8_t getCpuFreqMHz();
+};
+extern EspClass ESP;
+
+#endif // INCLUDED__TEST__SIM__ARDUINO
@@ -11,18 +11,12 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 
 #include <cstdio>
 #include <ostream>
-#include <sys/time.h>
 
 extern "C" {
 
 const ip_addr_t ip_addr_any = IPADDR4_INIT(IPADDR_ANY);
 
-/////////////////////////////////////////////////////////////////////////////
-unsigned long millis() {
-    timeval tv{ };
-    gettimeofday(&tv, nullptr);
-    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
-}
+// millis() is simulated time, see hlw8012_sim.cpp
 
 /////////////////////////////////////////////////////////////////////////////
 char* utoa(unsigned value, char* result, int base) {
@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test adaptive measurement publishing cadence
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "cadence.h"
+#include <initializer_list>
+
+namespace {
+    /// advance until publishing is due
+    /// @returns time of publish
+    unsigned long untilDue(Cadence& cadence, unsigned long& now) {
+        for (int i = 0; i < 100000; ++i) {
+            now += 10;
+            if (cadence.due(now)) return now;
+        }
+        FAIL("never due");
+        return now;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("Cadence") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("steady back-off") {
+        Cadence cadence;
+        CHECK(cadence.minMillis() == Cadence::DEFAULT_MIN_MILLIS);
+        CHECK(cadence.maxMillis() == Cadence::DEFAULT_MAX_MILLIS);
+
+        // intervals double up to the maximum
+        unsigned long now = 0;
+        auto last = untilDue(cadence, now);
+        for (const unsigned long expected : { 200, 400, 800, 1600, 3200, 5000, 5000 }) {
+            const auto publish = untilDue(cadence, now);
+            CHECK(publish - last == expected);
+            last = publish;
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("step") {
+        Cadence cadence;
+        cadence.setIntervals(100, 4000);
+
+        unsigned long now = 0;
+        cadence.measured(50000);
+        for (int i = 0; i < 8; ++i) untilDue(cadence, now);
+        CHECK(cadence.interval() == 4000);
+
+        // small changes aren't steps
+        cadence.measured(51000);
+        CHECK(false == cadence.due(now + 100));
+
+        // load switching on is published once the minimum interval passes
+        cadence.measured(1000000);
+        CHECK(false == cadence.due(now + 50));
+        CHECK(cadence.due(now + 100));
+        CHECK(cadence.interval() == 100);
+        now += 100;
+
+        // then backs off again
+        const auto stepped = now;
+        CHECK(untilDue(cadence, now) == stepped + 100);
+        CHECK(cadence.interval() == 200);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("isStep") {
+        CHECK(false == Cadence::isStep(0, 0));
+        CHECK(false == Cadence::isStep(2000, 0));
+        CHECK(Cadence::isStep(2001, 0));
+        CHECK(Cadence::isStep(0, 2001));
+
+        // relative to reference for larger loads
+        CHECK(false == Cadence::isStep(1100000, 1000000));
+        CHECK(Cadence::isStep(1100001, 1000000));
+        CHECK(Cadence::isStep(899999, 1000000));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("setIntervals") {
+        Cadence cadence;
+        cadence.setIntervals(10, 5);
+        CHECK(cadence.minMillis() == Cadence::LIMIT_MIN_MILLIS);
+        CHECK(cadence.maxMillis() == Cadence::LIMIT_MIN_MILLIS);
+
+        cadence.setIntervals(1000, 1000000);
+        CHECK(cadence.minMillis() == 1000);
+        CHECK(cadence.maxMillis() == Cadence::LIMIT_MAX_MILLIS);
+        CHECK(cadence.interval() == 1000);
+    }
+}
@@ -0,0 +1,95 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test energy accumulator
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "energy.h"
+#include "hlw8012.h"
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("Energy") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("accumulate") {
+        Energy energy;
+        CHECK(energy.totalWh() == 0);
+        CHECK(energy.todayWh() == 0);
+
+        // 1 kW for an hour
+        const auto pulsesPerHour = static_cast<uint32_t>(1000 / hlw8012::WATTS_PER_HZ * 3600);
+        for (int i = 0; i < 3600; ++i) energy.addPulses(pulsesPerHour / 3600);
+        energy.addPulses(pulsesPerHour % 3600);
+        CHECK(energy.totalWh() == doctest::Approx(1000).epsilon(0.001));
+        CHECK(energy.todayWh() == energy.totalWh());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("day rollover") {
+        Energy energy;
+        energy.addPulses(1000);
+        const auto before = energy.totalWh();
+
+        // first known day retains energy
+        energy.setDay(17000);
+        CHECK(energy.day() == 17000);
+        CHECK(energy.todayWh() == before);
+        CHECK(false == energy.saveDue(0));
+
+        // following day restarts today
+        energy.setDay(17001);
+        CHECK(energy.todayWh() == 0);
+        CHECK(energy.totalWh() == before);
+        CHECK(energy.saveDue(0));
+        energy.saved(0);
+        CHECK(false == energy.saveDue(0));
+
+        // unknown day is ignored
+        energy.addPulses(10);
+        energy.setDay(0);
+        CHECK(energy.day() == 17001);
+        CHECK(energy.todayWh() > 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("restore") {
+        Energy energy;
+        energy.restore(1234.5, 12.5, 17000);
+        CHECK(energy.totalWh() == doctest::Approx(1234.5));
+        CHECK(energy.todayWh() == doctest::Approx(12.5));
+        CHECK(energy.day() == 17000);
+
+        // same day continues
+        energy.setDay(17000);
+        CHECK(energy.todayWh() == doctest::Approx(12.5));
+
+        // restored from an earlier day
+        energy.setDay(17002);
+        CHECK(energy.todayWh() == 0);
+        CHECK(energy.totalWh() == doctest::Approx(1234.5));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("save schedule") {
+        Energy energy;
+        energy.saved(1000);
+        CHECK(false == energy.saveDue(1000 + Energy::SAVE_MAX_MILLIS)); // nothing to save
+
+        // small amounts wait for SAVE_MAX_MILLIS
+        energy.addPulses(1);
+        CHECK(false == energy.saveDue(1000 + Energy::SAVE_MIN_MILLIS));
+        CHECK(energy.saveDue(1000 + Energy::SAVE_MAX_MILLIS));
+
+        // larger amounts after SAVE_MIN_MILLIS
+        const auto pulses = static_cast<uint32_t>(Energy::SAVE_MIN_WH * 3600 / hlw8012::WATTS_PER_HZ) + 1;
+        energy.addPulses(pulses);
+        CHECK(false == energy.saveDue(1000 + Energy::SAVE_MIN_MILLIS - 1));
+        CHECK(energy.saveDue(1000 + Energy::SAVE_MIN_MILLIS));
+
+        energy.saved(5000);
+        CHECK(false == energy.saveDue(5000 + Energy::SAVE_MAX_MILLIS));
+    }
+}
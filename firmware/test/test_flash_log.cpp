@@ -0,0 +1,294 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test flash log
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "flash_log.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+    /////////////////////////////////////////////////////////////////////////
+    /// RAM backed NOR flash
+    class RamStorage : public FlashLogStorage {
+    public:
+        explicit RamStorage(uint32_t sectors)
+        : data_(sectors * SECTOR_SIZE, 0xFF)
+        , erases_(sectors, 0)
+        { }
+
+        uint32_t sectors() const override { return static_cast<uint32_t>(erases_.size()); }
+
+        bool erase(uint32_t sector) override {
+            memset(&data_[sector * SECTOR_SIZE], 0xFF, SECTOR_SIZE);
+            ++erases_[sector];
+            return true;
+        }
+        bool read(uint32_t sector, uint32_t offset, void* data, uint32_t size) const override {
+            ++reads_;
+            memcpy(data, &data_[sector * SECTOR_SIZE + offset], size);
+            return true;
+        }
+        bool write(uint32_t sector, uint32_t offset, const void* data, uint32_t size) override {
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            for (uint32_t i = 0; i < size; ++i) data_[sector * SECTOR_SIZE + offset + i] &= bytes[i];
+            return true;
+        }
+
+        /// raw access
+        uint8_t& at(uint32_t sector, uint32_t offset) { return data_[sector * SECTOR_SIZE + offset]; }
+
+        /// erases of sector
+        uint32_t erases(uint32_t sector) const { return erases_[sector]; }
+        /// reads performed
+        uint32_t reads() const { return reads_; }
+        void resetReads() { reads_ = 0; }
+
+    private:
+        std::vector<uint8_t>    data_;      ///< sector contents
+        std::vector<uint32_t>   erases_;    ///< erase counts per sector
+        mutable uint32_t        reads_{0};  ///< read count
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    /// record with time
+    FlashLogRecord makeRecord(uint32_t time) {
+        FlashLogRecord record{};
+        record.time = time;
+        record.deciWatts = static_cast<uint16_t>(time);
+        record.deciWattsMax = static_cast<uint16_t>(time + 1);
+        record.deciVolts = 1200;
+        return record;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// read all record times
+    std::vector<uint32_t> readTimes(const FlashLog& log) {
+        std::vector<uint32_t> times;
+        FlashLog::Reader reader{log};
+        FlashLogRecord record;
+        while (reader.next(record)) times.push_back(record.time);
+        return times;
+    }
+
+    /// consecutive times [first, last]
+    std::vector<uint32_t> range(uint32_t first, uint32_t last) {
+        std::vector<uint32_t> times;
+        for (auto t = first; t <= last; ++t) times.push_back(t);
+        return times;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("FlashLog") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("empty") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+        CHECK(log.empty());
+        CHECK(readTimes(log).empty());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("append and read") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+
+        for (uint32_t t = 1; t <= 500; ++t) CHECK(log.append(makeRecord(t)));
+        CHECK(false == log.empty());
+        CHECK(log.head() == 1);
+        CHECK(log.headRecords() == 500 - FlashLog::RECORDS_PER_SECTOR);
+        CHECK(readTimes(log) == range(1, 500));
+
+        FlashLog::Reader reader{log};
+        FlashLogRecord record;
+        CHECK(reader.next(record));
+        CHECK(record.deciWatts == 1);
+        CHECK(record.deciWattsMax == 2);
+        CHECK(record.deciVolts == 1200);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("reads") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+        for (uint32_t t = 1; t <= 500; ++t) log.append(makeRecord(t));
+
+        // one read per record, plus a header per sector and the erased end
+        storage.resetReads();
+        CHECK(readTimes(log).size() == 500);
+        CHECK(storage.reads() == 500 + 2 + 1);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("overwritten while reading") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+        const uint32_t total = FlashLog::RECORDS_PER_SECTOR * 4;
+        for (uint32_t t = 1; t <= total; ++t) log.append(makeRecord(t));
+
+        FlashLog::Reader reader{log};
+        FlashLogRecord record;
+        REQUIRE(reader.next(record));
+        CHECK(record.time == 1);
+
+        // log wraps around over the sector being read, which ends it
+        log.append(makeRecord(total + 1));
+        REQUIRE(reader.next(record));
+        CHECK(record.time == FlashLog::RECORDS_PER_SECTOR + 1);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("wrap around") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+
+        // 10 passes around the log
+        const uint32_t total = FlashLog::RECORDS_PER_SECTOR * 4 * 10 + 7;
+        for (uint32_t t = 1; t <= total; ++t) log.append(makeRecord(t));
+
+        // holds the 3 most recent full sectors, plus the newest partial sector
+        CHECK(log.headRecords() == 7);
+        CHECK(readTimes(log) == range(total - 7 - 3 * FlashLog::RECORDS_PER_SECTOR + 1, total));
+
+        // each sector erased once per pass
+        for (uint32_t s = 0; s < 4; ++s) {
+            CHECK(storage.erases(s) >= 10);
+            CHECK(storage.erases(s) <= 11);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("recovery") {
+        const uint32_t SECTORS = 64;
+        RamStorage storage{SECTORS};
+
+        for (const uint32_t total : { 1u, 339u, 340u, 341u, 5000u, 21759u, 21760u, 21761u, 50000u }) {
+            CAPTURE(total);
+            for (uint32_t s = 0; s < SECTORS; ++s) storage.erase(s);
+
+            uint32_t head = 0, headSeq = 0, headRecords = 0;
+            {
+                FlashLog log{storage};
+                log.begin();
+                for (uint32_t t = 1; t <= total; ++t) log.append(makeRecord(t));
+                head = log.head();
+                headSeq = log.headSequence();
+                headRecords = log.headRecords();
+            }
+
+            // reboot, binary search recovers write position
+            storage.resetReads();
+            FlashLog log{storage};
+            log.begin();
+            CHECK(storage.reads() <= 2 * 8 + 2);
+            CHECK(log.head() == head);
+            CHECK(log.headSequence() == headSeq);
+            CHECK(log.headRecords() == headRecords);
+
+            // continues appending
+            log.append(makeRecord(total + 1));
+            const auto times = readTimes(log);
+            REQUIRE(false == times.empty());
+            CHECK(times.back() == total + 1);
+            CHECK(times == range(times.front(), total + 1));
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("interrupted erase") {
+        RamStorage storage{4};
+        const uint32_t total = FlashLog::RECORDS_PER_SECTOR * 4;
+        {
+            FlashLog log{storage};
+            log.begin();
+            for (uint32_t t = 1; t <= total; ++t) log.append(makeRecord(t));
+            CHECK(log.head() == 3);
+        }
+
+        // power lost after erasing sector 0 to wrap around
+        storage.erase(0);
+
+        FlashLog log{storage};
+        log.begin();
+        CHECK(log.head() == 3);
+        CHECK(log.headRecords() == FlashLog::RECORDS_PER_SECTOR);
+        CHECK(readTimes(log) == range(FlashLog::RECORDS_PER_SECTOR + 1, total));
+
+        log.append(makeRecord(total + 1));
+        CHECK(log.head() == 0);
+        CHECK(readTimes(log) == range(FlashLog::RECORDS_PER_SECTOR + 1, total + 1));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("corrupt record") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+        for (uint32_t t = 1; t <= 10; ++t) log.append(makeRecord(t));
+
+        // partially written 5th record
+        storage.at(0, FlashLog::HEADER_SIZE + 4 * sizeof(FlashLogRecord) + 4) = 0;
+
+        auto expected = range(1, 10);
+        expected.erase(expected.begin() + 4);
+        CHECK(readTimes(log) == expected);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("minute records") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+
+        for (uint16_t i = 0; i < 59; ++i) log.add(1000 + i, HistorySample{ i, 1200 });
+        CHECK(log.empty());
+        log.add(1059, HistorySample{ 59, 1210 });
+        CHECK(false == log.empty());
+
+        FlashLog::Reader reader{log};
+        FlashLogRecord record;
+        REQUIRE(reader.next(record));
+        CHECK(record.time == 1059);
+        CHECK(record.deciWatts == 30); // 29.5 rounded
+        CHECK(record.deciWattsMax == 59);
+        CHECK(record.deciVolts == 1200);
+        CHECK(false == reader.next(record));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("stream") {
+        RamStorage storage{4};
+        FlashLog log{storage};
+        log.begin();
+        for (uint32_t t = 1; t <= 100; ++t) log.append(makeRecord(t));
+
+        // odd sized reads split records
+        std::vector<uint8_t> bytes;
+        FlashLog::Reader reader{log};
+        uint8_t buffer[7];
+        for (;;) {
+            const auto len = reader.read(buffer, sizeof(buffer));
+            if (0 == len) break;
+            bytes.insert(bytes.end(), buffer, buffer + len);
+        }
+
+        REQUIRE(bytes.size() == 100 * sizeof(FlashLogRecord));
+        for (uint32_t i = 0; i < 100; ++i) {
+            FlashLogRecord record;
+            memcpy(&record, &bytes[i * sizeof(record)], sizeof(record));
+            CHECK(record.time == i + 1);
+            CHECK(record.check == FlashLog::checksum(record));
+        }
+    }
+}
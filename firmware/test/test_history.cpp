@@ -0,0 +1,97 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test measurement history
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "history.h"
+#include <memory>
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("History") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("toDeci") {
+        CHECK(History::toDeci(0) == 0);
+        CHECK(History::toDeci(-5) == 0);
+        CHECK(History::toDeci(12.34f) == 123);
+        CHECK(History::toDeci(12.35f) == 124);
+        CHECK(History::toDeci(6553.4f) == 65534);
+        CHECK(History::toDeci(100000) == 65535);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("seconds") {
+        std::unique_ptr<History> history{ new History };
+        CHECK(history->interval(0) == 1);
+        CHECK(history->begin(0) == 0);
+        CHECK(history->end(0) == 0);
+
+        history->add(1.5f, 120.1f);
+        history->add(2.5f, 120.2f);
+        CHECK(history->begin(0) == 0);
+        CHECK(history->end(0) == 2);
+        CHECK(history->at(0, 0).deciWatts == 15);
+        CHECK(history->at(0, 0).deciVolts == 1201);
+        CHECK(history->at(0, 1).deciWatts == 25);
+
+        // oldest blocks are dropped once full
+        uint32_t count = 2;
+        for (; 0 == history->begin(0); ++count) {
+            history->add(float(count % 1000), 120);
+        }
+        CHECK(history->end(0) == count);
+        CHECK(history->begin(0) > 0);
+        CHECK(history->at(0, count - 1).deciWatts == ((count - 1) % 1000) * 10);
+
+        // read consecutive samples
+        uint32_t expected = history->begin(0);
+        history->read(0, 0, count, [&expected](uint32_t seq, const History::Sample& sample) {
+            CHECK(seq == expected);
+            CHECK(sample.deciWatts == (seq % 1000) * 10);
+            CHECK(sample.deciVolts == 1200);
+            ++expected;
+        });
+        CHECK(expected == count);
+
+        // partial read
+        expected = count - 10;
+        history->read(0, expected, 5, [&expected](uint32_t seq, const History::Sample&) {
+            CHECK(seq == expected);
+            ++expected;
+        });
+        CHECK(expected == count - 5);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("downsampling") {
+        std::unique_ptr<History> history{ new History };
+        CHECK(history->interval(1) == 60);
+        CHECK(history->interval(2) == 3600);
+
+        // first minute averages 0..59 W
+        for (int i = 0; i < 60; ++i) history->add(float(i), 230);
+        CHECK(history->end(1) == 1);
+        CHECK(history->at(1, 0).deciWatts == 295);
+        CHECK(history->at(1, 0).deciVolts == 2300);
+
+        // a steady hour
+        for (int i = 60; i < 3600; ++i) history->add(100, 240);
+        CHECK(history->end(1) == 60);
+        CHECK(history->at(1, 59).deciWatts == 1000);
+        CHECK(history->end(2) == 1);
+        CHECK(history->at(2, 0).deciWatts == (295 + 59 * 1000 + 30) / 60);
+
+        // a steady week is retained in full
+        for (int i = 0; i < 3600 * 24 * 7; ++i) history->add(50, 240);
+        CHECK(history->end(2) == 1 + 24 * 7);
+        CHECK(history->begin(2) == 0);
+        CHECK(history->begin(1) == 0);
+        CHECK(history->end(0) - history->begin(0) >= 3600);
+        CHECK(history->at(2, history->end(2) - 1).deciWatts == 500);
+        CHECK(history->at(1, 0).deciWatts == 295);
+    }
+}
@@ -0,0 +1,186 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test compressed history blocks
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "history_block.h"
+#include <chrono>
+#include <vector>
+
+namespace {
+    /////////////////////////////////////////////////////////////////////////
+    /// deterministic pseudo random numbers
+    class Random {
+    public:
+        uint32_t next() {
+            state_ = state_ * 1664525 + 1013904223;
+            return state_ >> 8;
+        }
+    private:
+        uint32_t state_{12345};
+    };
+
+    /////////////////////////////////////////////////////////////////////////
+    /// plausible 1 s samples: a load switching between a few levels, with
+    /// some measurement noise, and mains voltage wandering around 120 V
+    std::vector<HistorySample> plausibleSamples(size_t count) {
+        Random random;
+        std::vector<HistorySample> samples;
+        samples.reserve(count);
+
+        uint16_t deciWatts = 0;
+        uint16_t deciVolts = 1200;
+        for (size_t i = 0; i < count; ++i) {
+            if (0 == random.next() % 300) {
+                static const uint16_t LOADS[] = { 0, 5, 600, 12000 };
+                deciWatts = LOADS[random.next() % 4];
+            }
+            if (0 == random.next() % 4) {
+                deciVolts = static_cast<uint16_t>(deciVolts + (random.next() % 3) - 1);
+            }
+
+            const auto noise = (deciWatts > 100) ? (random.next() % 3) : 1;
+            samples.push_back(HistorySample{ static_cast<uint16_t>(deciWatts + noise - 1), deciVolts });
+        }
+        return samples;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// encode samples into as many blocks as needed
+    std::vector<HistoryBlock> encode(const std::vector<HistorySample>& samples) {
+        std::vector<HistoryBlock> blocks(1);
+        blocks.back().reset(0);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            if (blocks.back().append(samples[i])) continue;
+
+            blocks.emplace_back();
+            blocks.back().reset(static_cast<uint32_t>(i));
+            REQUIRE(blocks.back().append(samples[i]));
+        }
+        return blocks;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// decode all blocks
+    std::vector<HistorySample> decode(const std::vector<HistoryBlock>& blocks) {
+        std::vector<HistorySample> samples;
+        for (const auto& block : blocks) {
+            HistoryBlock::Decoder decoder{block};
+            HistorySample sample;
+            while (decoder.next(sample)) samples.push_back(sample);
+        }
+        return samples;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// check decoded samples match
+    void checkSamples(const std::vector<HistorySample>& decoded, const std::vector<HistorySample>& expected) {
+        REQUIRE(decoded.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            if (decoded[i].deciWatts != expected[i].deciWatts || decoded[i].deciVolts != expected[i].deciVolts) {
+                FAIL("sample " << i << " mismatch");
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("HistoryBlock") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("empty") {
+        HistoryBlock block;
+        block.reset(42);
+        CHECK(block.start() == 42);
+        CHECK(block.count() == 0);
+        CHECK(block.end() == 42);
+
+        HistoryBlock::Decoder decoder{block};
+        HistorySample sample;
+        CHECK(false == decoder.next(sample));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("round trip") {
+        // every code length, including wrapping extremes
+        const std::vector<HistorySample> samples{
+            { 1000, 1200 }, { 1000, 1200 }, { 1001, 1199 }, { 1008, 1199 }, { 992, 1199 },
+            { 1050, 1260 }, { 950, 1140 }, { 0, 0 }, { 65535, 65535 }, { 0, 1 }, { 32768, 32767 },
+            { 0, 65535 }, { 200, 1200 },
+        };
+        const auto blocks = encode(samples);
+        CHECK(blocks.size() == 1);
+        CHECK(blocks[0].count() == samples.size());
+        checkSamples(decode(blocks), samples);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("full") {
+        // worst case, all values change wildly
+        Random random;
+        std::vector<HistorySample> samples;
+        for (int i = 0; i < 1000; ++i) {
+            samples.push_back(HistorySample{ static_cast<uint16_t>(random.next()), static_cast<uint16_t>(random.next()) });
+        }
+
+        const auto blocks = encode(samples);
+        CHECK(blocks.size() > 1);
+        CHECK(blocks[0].count() >= HistoryBlock::BITS_BYTES * 8 / (2 * 19));
+        CHECK(blocks[1].start() == blocks[0].end());
+        checkSamples(decode(blocks), samples);
+
+        // full block is unchanged by a failed append
+        auto block = blocks[0];
+        CHECK(false == block.append(HistorySample{ 12345, 54321 }));
+        CHECK(block.count() == blocks[0].count());
+        HistoryBlock::Decoder decoder{block};
+        HistorySample sample;
+        for (uint32_t i = 0; i < block.count(); ++i) CHECK(decoder.next(sample));
+        CHECK(sample.deciWatts == samples[block.count() - 1].deciWatts);
+        CHECK(false == decoder.next(sample));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// ratio against holding samples as a pair of floats
+    TEST_CASE("compression") {
+        const auto samples = plausibleSamples(100000);
+        const auto blocks = encode(samples);
+        checkSamples(decode(blocks), samples);
+
+        const auto bytes = blocks.size() * sizeof(HistoryBlock);
+        const auto ratioFloat = double(samples.size() * 2 * sizeof(float)) / bytes;
+        const auto ratioDeci = double(samples.size() * sizeof(HistorySample)) / bytes;
+        MESSAGE("samples per block: " << double(samples.size()) / blocks.size());
+        MESSAGE("ratio vs float: " << ratioFloat << ", ratio vs uint16: " << ratioDeci);
+        CHECK(ratioFloat >= 10);
+
+        // steady values
+        const std::vector<HistorySample> steady(10000, HistorySample{ 500, 1200 });
+        const auto steadyBlocks = encode(steady);
+        CHECK(double(steady.size() * 2 * sizeof(float)) / (steadyBlocks.size() * sizeof(HistoryBlock)) >= 20);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("benchmark") {
+        const auto samples = plausibleSamples(100000);
+
+        const auto startEncode = std::chrono::steady_clock::now();
+        const auto blocks = encode(samples);
+        const auto elapsedEncode = std::chrono::steady_clock::now() - startEncode;
+
+        const auto startDecode = std::chrono::steady_clock::now();
+        const auto decoded = decode(blocks);
+        const auto elapsedDecode = std::chrono::steady_clock::now() - startDecode;
+
+        using Nanos = std::chrono::duration<double, std::nano>;
+        const auto nsEncode = Nanos(elapsedEncode).count() / samples.size();
+        const auto nsDecode = Nanos(elapsedDecode).count() / samples.size();
+
+        CHECK(decoded.size() == samples.size());
+        MESSAGE("encode: " << nsEncode << " ns/sample, decode: " << nsDecode << " ns/sample");
+    }
+}
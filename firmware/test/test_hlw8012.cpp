@@ -0,0 +1,107 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test HLW8012 conversions
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "hlw8012.h"
+#include <chrono>
+#include <cmath>
+#include <string>
+
+namespace {
+    /////////////////////////////////////////////////////////////////////////
+    /// reference double based conversions (as originally performed by the ISR)
+    const auto FOSC = 3579000.0;
+    const auto VREF = 2.43;
+    const auto ONE_MICROS = 1000000; // 1 microsecond
+    const auto V1_R = 0.002;
+    const auto V2_R1 = 2 * 953000.0;
+    const auto V2_R2 = 1000.0;
+    const auto V2_RDIV = V2_R2 / (V2_R1 + V2_R2);
+
+    double referenceVoltage(uint32_t pulseWidth) {
+        const auto freq = ONE_MICROS / (2.0 * pulseWidth);
+        const auto v2 = freq * 512 / FOSC * VREF / 2.0;
+        return v2 / V2_RDIV;
+    }
+    double referencePower(uint32_t pulseWidth) {
+        const auto freq = ONE_MICROS / (2.0 * pulseWidth);
+        const auto v1v2 = freq * 128 / FOSC * (VREF * VREF) / 48.0;
+        return v1v2 / V2_RDIV / V1_R;
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// time ITERATIONS conversions over a sweep of pulse widths
+    /// @returns nanoseconds per conversion
+    template <typename Func>
+    double benchmark(Func func) {
+        const int ITERATIONS = 1000000;
+        volatile uint32_t sink = 0; // prevent the conversions being optimized away
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < ITERATIONS; ++i) {
+            sink = sink + static_cast<uint32_t>(func(100 + (i & 0xFFFF)));
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        return std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("hlw8012") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("pulse width accuracy") {
+        CHECK(hlw8012::milliVoltsFromPulseWidth(0) == 0);
+        CHECK(hlw8012::milliWattsFromPulseWidth(0) == 0);
+
+        // sweep ~20 us through to 10 s wide pulses
+        for (uint32_t pulseWidth = 20; pulseWidth < 10000000; pulseWidth += pulseWidth / 50 + 1) {
+            const auto mV = referenceVoltage(pulseWidth) * 1000;
+            const auto mW = referencePower(pulseWidth) * 1000;
+
+            // integer truncation => within 1 unit
+            CHECK(std::fabs(hlw8012::milliVoltsFromPulseWidth(pulseWidth) - mV) <= 1.0);
+            CHECK(std::fabs(hlw8012::milliWattsFromPulseWidth(pulseWidth) - mW) <= 1.0);
+        }
+
+        // 120 V mains ~= 1381 us CF1 pulses
+        CHECK(hlw8012::milliVoltsFromPulseWidth(1381) == 120008);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("frequency accuracy") {
+        CHECK(hlw8012::milliVoltsFromFrequency(0) == 0);
+        CHECK(hlw8012::milliWattsFromFrequency(0) == 0);
+
+        // sweep 0.001 Hz through to 2 kHz
+        for (uint32_t milliHz = 1; milliHz < 2000000; milliHz += milliHz / 50 + 1) {
+            const auto mV = hlw8012::VOLTS_PER_HZ * milliHz;
+            const auto mW = hlw8012::WATTS_PER_HZ * milliHz;
+
+            // Q24 scale factor error + truncation
+            CHECK(std::fabs(hlw8012::milliVoltsFromFrequency(milliHz) - mV) <= 1.0 + mV * 1e-6);
+            CHECK(std::fabs(hlw8012::milliWattsFromFrequency(milliHz) - mW) <= 1.0 + mW * 1e-6);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    /// host timings are indicative only, the ESP8266 has no FPU which
+    /// heavily penalizes the double based conversions
+    TEST_CASE("benchmark") {
+        const auto nsDoubleV = benchmark([](uint32_t w) { return referenceVoltage(w) * 1000; });
+        const auto nsDoubleW = benchmark([](uint32_t w) { return referencePower(w) * 1000; });
+        const auto nsFixedV  = benchmark(hlw8012::milliVoltsFromPulseWidth);
+        const auto nsFixedW  = benchmark(hlw8012::milliWattsFromPulseWidth);
+        const auto nsFreqW   = benchmark(hlw8012::milliWattsFromFrequency);
+
+        MESSAGE("double voltage: " << nsDoubleV << " ns, fixed voltage: " << nsFixedV << " ns");
+        MESSAGE("double power: "   << nsDoubleW << " ns, fixed power: "   << nsFixedW << " ns");
+        MESSAGE("fixed power from frequency: " << nsFreqW << " ns");
+    }
+}
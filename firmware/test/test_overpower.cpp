@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test overpower protection
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "hlw8012.h"
+#include "overpower.h"
+
+namespace {
+    /// CF period (us) for watts
+    uint32_t periodMicros(double watts) {
+        return static_cast<uint32_t>(1000000 * hlw8012::WATTS_PER_HZ / watts);
+    }
+
+    /// feed falling edges at watts for count periods
+    /// @returns number of edges before tripping (or count)
+    int feed(Overpower& overpower, uint32_t& time, double watts, int count, uint32_t ticksPerMicro = 1) {
+        const auto period = periodMicros(watts) * ticksPerMicro;
+        for (int i = 0; i < count; ++i) {
+            time += period;
+            if (overpower.edge(time)) return i;
+        }
+        return count;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("Overpower") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("disabled") {
+        Overpower overpower;
+        CHECK(false == overpower.enabled());
+
+        uint32_t time = 0;
+        CHECK(feed(overpower, time, 5000, 100) == 100);
+        CHECK(false == overpower.tripped());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("trip") {
+        Overpower overpower;
+        overpower.configure(1000000, 0, 80); // 1 kW
+        CHECK(overpower.enabled());
+
+        // below limit
+        uint32_t time = 0x12345678;
+        CHECK(feed(overpower, time, 990, 100, 80) == 100);
+
+        // above limit trips on the second short period
+        CHECK(feed(overpower, time, 1100, 100, 80) == 1);
+        CHECK(overpower.tripped());
+        CHECK(overpower.tripMilliWatts() == doctest::Approx(1100000).epsilon(0.001));
+
+        // remains tripped until cleared
+        CHECK(feed(overpower, time, 2000, 10, 80) == 10);
+        CHECK(overpower.tripped());
+        overpower.clear();
+        CHECK(false == overpower.tripped());
+        CHECK(feed(overpower, time, 990, 10, 80) == 10);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("single period") {
+        Overpower overpower;
+        overpower.configure(1000000, 0, 1);
+
+        // isolated short periods don't trip
+        uint32_t time = 0;
+        for (int i = 0; i < 10; ++i) {
+            CHECK(feed(overpower, time, 500, 5) == 5);
+            CHECK(feed(overpower, time, 1500, 1) == 1);
+        }
+
+        // nor do glitches
+        time += Overpower::GLITCH_MICROS - 1;
+        CHECK(false == overpower.edge(time));
+        CHECK(feed(overpower, time, 500, 5) == 5);
+        CHECK(false == overpower.tripped());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("inrush") {
+        Overpower overpower;
+        overpower.configure(1000000, 100, 1); // 1 kW, 100 ms
+
+        // 2 kW surge for ~50 ms is allowed
+        uint32_t time = 0;
+        CHECK(feed(overpower, time, 500, 5) == 5);
+        const auto surge = 50000 / periodMicros(2000);
+        CHECK(feed(overpower, time, 2000, surge) == surge);
+        CHECK(feed(overpower, time, 500, 5) == 5);
+
+        // sustained overpower trips after the allowance
+        const auto start = time;
+        CHECK(feed(overpower, time, 2000, 1000) < 1000);
+        CHECK(time - start >= 100000);
+        CHECK(time - start < 100000 + periodMicros(2000));
+    }
+}
@@ -8,8 +8,11 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 
 //- includes
 #include "doctest_ext.h"
+#include "print_buffer.h"
 #include "property.h"
+#include "property_record.h"
 #include <string>
+#include <vector>
 
 /////////////////////////////////////////////////////////////////////////////
 /// convert property tree to a JSON string
@@ -21,6 +24,44 @@ std::string toJson(PropertyNode& property, int flags = 0) {
     return out;
 }
 
+/////////////////////////////////////////////////////////////////////////////
+/// print property tree to a JSON string
+std::string printJson(PropertyNode& property, int flags = 0, uint32_t since = 0) {
+    uint8_t buffer[2048];
+    PrintBuffer out{buffer, sizeof(buffer)};
+    const auto len = property.printJson(out, flags, since);
+    CHECK(len == out.length());
+    return std::string{reinterpret_cast<const char*>(buffer), out.length()};
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// print property tree as MessagePack bytes
+std::vector<uint8_t> printMsgPack(PropertyNode& property, int flags = 0, uint32_t since = 0) {
+    uint8_t buffer[2048];
+    PrintBuffer out{buffer, sizeof(buffer)};
+    const auto len = property.printMsgPack(out, flags, since);
+    CHECK(len == out.length());
+    return std::vector<uint8_t>{buffer, buffer + out.length()};
+}
+
+/////////////////////////////////////////////////////////////////////////////
+/// record schema
+struct TestSchema {
+    struct Values {
+        bool        on;
+        int         level;
+        unsigned    count;
+        float       ratio;
+    };
+    static constexpr PropertyField FIELDS[] = {
+        PROPERTY_FIELD(Values, on, 0),
+        PROPERTY_FIELD(Values, level, Property::PERSIST),
+        PROPERTY_FIELD(Values, count, 0),
+        PROPERTY_FIELD(Values, ratio, Property::PERSIST),
+    };
+};
+constexpr PropertyField TestSchema::FIELDS[];
+
 /////////////////////////////////////////////////////////////////////////////
 TEST_SUITE("Property") {
     /////////////////////////////////////////////////////////////////////////
@@ -30,11 +71,11 @@ TEST_SUITE("Property") {
         PropertyInt    prop_child1{ &prop_parent, "int", 1 };
         PropertyString prop_child2{ &prop_parent, "str", "string" };
 
-        CHECK(prop_root.name() == "");
-        CHECK(prop_parent.name() == "parent");
-        CHECK(prop_child1.name() == "int");
+        CHECK(std::string{prop_root.name()} == "");
+        CHECK(std::string{prop_parent.name()} == "parent");
+        CHECK(std::string{prop_child1.name()} == "int");
         CHECK(prop_child1.value() == 1);
-        CHECK(prop_child2.name() == "str");
+        CHECK(std::string{prop_child2.name()} == "str");
         CHECK(prop_child2.value() == "string");
         CHECK(prop_child2->length() == 6);
     }
@@ -43,51 +84,51 @@ TEST_SUITE("Property") {
     TEST_CASE("toJson") {
         PropertyNode root;
         CHECK(String{} == root.name());
-        CHECK(root.dirty());
+        CHECK(root.changed() == Property::generation());
         CHECK(toJson(root) == R"({})");
 
         {
             PropertyNode prop_parent{ &root, "parent" };
-            CHECK(prop_parent.name() == "parent");
-            CHECK(prop_parent.dirty());
+            CHECK(std::string{prop_parent.name()} == "parent");
+            CHECK(prop_parent.changed() == Property::generation());
             CHECK(toJson(root) == R"({"parent":{}})");
 
             PropertyInt prop_child{ &root, "child", 0 };
-            CHECK(prop_child.name() == "child");
+            CHECK(std::string{prop_child.name()} == "child");
             CHECK(prop_child.value() == 0);
-            CHECK(prop_child.dirty());
+            CHECK(prop_child.changed() == Property::generation());
             CHECK(toJson(root) == R"({"parent":{},"child":0})");
 
             {
                 PropertyBool prop_parent_child1{ &prop_parent, "bool", false };
-                CHECK(prop_parent_child1.name() == "bool");
+                CHECK(std::string{prop_parent_child1.name()} == "bool");
                 CHECK(prop_parent_child1.value() == false);
-                CHECK(prop_parent_child1.dirty());
+                CHECK(prop_parent_child1.changed() == Property::generation());
                 CHECK(toJson(root) == R"({"parent":{"bool":false},"child":0})");
 
                 prop_parent_child1.set(true);
                 CHECK(prop_parent_child1.value() == true);
-                CHECK(prop_parent_child1.dirty());
+                CHECK(prop_parent_child1.changed() == Property::generation());
                 CHECK(toJson(root) == R"({"parent":{"bool":true},"child":0})");
 
                 {
                     PropertyInt prop_parent_child2{ &prop_parent, "int", 314 };
-                    CHECK(prop_parent_child2.name() == "int");
+                    CHECK(std::string{prop_parent_child2.name()} == "int");
                     CHECK(prop_parent_child2.value() == 314);
-                    CHECK(prop_parent_child2.dirty());
+                    CHECK(prop_parent_child2.changed() == Property::generation());
                     CHECK(toJson(root) == R"({"parent":{"bool":true,"int":314},"child":0})");
 
                     prop_parent_child2.set(123);
                     CHECK(prop_parent_child2.value() == 123);
-                    CHECK(prop_parent_child2.dirty());
+                    CHECK(prop_parent_child2.changed() == Property::generation());
                     CHECK(toJson(root) == R"({"parent":{"bool":true,"int":123},"child":0})");
                 }
 
                 {
                     PropertyIpAddress prop_parent_child2{ &prop_parent, "ip", IPAddress{192, 168, 1, 100} };
-                    CHECK(prop_parent_child2.name() == "ip");
+                    CHECK(std::string{prop_parent_child2.name()} == "ip");
                     CHECK(prop_parent_child2.value().toString() == "192.168.1.100");
-                    CHECK(prop_parent_child2.dirty());
+                    CHECK(prop_parent_child2.changed() == Property::generation());
                     CHECK(toJson(root) == R"({"parent":{"bool":true,"ip":"192.168.1.100"},"child":0})");
                 }
 
@@ -99,82 +140,57 @@ TEST_SUITE("Property") {
     }
 
     /////////////////////////////////////////////////////////////////////////
-    TEST_CASE("toJson dirty") {
+    TEST_CASE("changes since") {
         PropertyNode root;
-        CHECK(root.dirty());
-        CHECK(toJson(root, Property::DIRTY) == R"({})"); // empty
-        CHECK(false == root.dirty());
+        uint32_t since = 0;
+        const auto changes = [&root, &since] {
+            const auto json = printJson(root, 0, since);
+            since = Property::generation();
+            return json;
+        };
+        CHECK(changes() == R"({})"); // empty
 
         {
             PropertyNode parent{ &root, "parent" };
-            CHECK(root.dirty());
-            CHECK(toJson(root, Property::DIRTY) == R"({"parent":{}})");
-            CHECK(false == root.dirty());
-            CHECK(toJson(root, Property::DIRTY) == R"({})"); // no change
-            CHECK(false == root.dirty());
+            CHECK(root.changed() > since);
+            CHECK(changes() == R"({})"); // only leaves are changes
 
             PropertyInt child{ &parent, "child", 123 };
-            CHECK(root.dirty());
-            CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child":123}})");
-            CHECK(false == root.dirty());
-            CHECK(toJson(root, Property::DIRTY) == R"({})"); // no changes
-            CHECK(false == root.dirty());
+            CHECK(root.changed() > since);
+            CHECK(changes() == R"({"parent":{"child":123}})");
+            CHECK(root.changed() == since);
+            CHECK(changes() == R"({})"); // no changes
 
             {
                 PropertyInt child2{ &parent, "child2", 234 };
-                CHECK(root.dirty());
-                CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child2":234}})");
-                CHECK(toJson(root, Property::DIRTY) == R"({})"); // no changes
-                CHECK(false == root.dirty());
+                CHECK(changes() == R"({"parent":{"child2":234}})");
+                CHECK(changes() == R"({})"); // no changes
 
                 child.set(345);
-                CHECK(root.dirty());
-                CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child":345}})");
-                CHECK(false == root.dirty());
+                CHECK(root.changed() > since);
+                CHECK(changes() == R"({"parent":{"child":345}})");
 
                 child.set(1);
                 child2.set(2);
-                CHECK(root.dirty());
-                CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child":1,"child2":2}})");
-                CHECK(false == root.dirty());
+                CHECK(changes() == R"({"parent":{"child":1,"child2":2}})");
+                CHECK(root.changed() == since);
             }
-
-            // child2 removed
-            // CHECK(root.dirty());
-            // CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child2":null}})"); // removed
-            // CHECK(false == root.dirty());
         }
-
-        // parent + child removed
-        // CHECK(root.dirty());
-        // CHECK(toJson(root, Property::DIRTY) == R"({"parent":null})"); // removed
-        // CHECK(false == root.dirty());
     }
 
     /////////////////////////////////////////////////////////////////////////
-    TEST_CASE("toJson dirty persistence") {
+    TEST_CASE("toJson persistence") {
         PropertyNode root;
         CHECK(toJson(root, Property::PERSIST) == R"({})"); // empty
 
         PropertyNode prop_parent{ &root, "parent" };
         PropertyInt prop_child1{ &prop_parent, "child1", 1 };
         PropertyInt prop_child2{ &prop_parent, "child2", 2 };
-        CHECK(root.dirty());
         CHECK(false == root.persistDirty());
-
-        // grabbing persistent properties does not clear dirty flag
         CHECK(toJson(root, Property::PERSIST) == R"({})");
-        CHECK(root.dirty());
-        CHECK(false == root.persistDirty());
-
-        // retrieve dirty clears dirty
-        CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child1":1,"child2":2}})");
-        CHECK(false == root.dirty());
-        CHECK(false == root.persistDirty());
 
         // setting persistent doesn't mark dirty
         prop_child2.setPersist();
-        CHECK(false == root.dirty());
         CHECK(false == root.persistDirty());
 
         // can retrieve persisted nodes
@@ -182,51 +198,28 @@ TEST_SUITE("Property") {
 
         // setting value marks dirty
         prop_child2.set(-2);
-        CHECK(root.dirty());
         CHECK(root.persistDirty());
 
         // retrieve persisted clears persisted dirty
         CHECK(toJson(root, Property::PERSIST) == R"({"parent":{"child2":-2}})");
-        CHECK(root.dirty());
         CHECK(false == root.persistDirty());
 
-        CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child2":-2}})");
-        CHECK(false == root.dirty());
-        CHECK(false == root.persistDirty());
-
-
         // add another persistent property
         PropertyNode prop_parent2{ &root, "parent2" };
         PropertyInt prop_child3{ &prop_parent2, "child3", 3, Property::PERSIST };
-        CHECK(root.dirty());            // dirty because we added a new node
         CHECK(false == root.persistDirty());
-
-        CHECK(toJson(root, Property::DIRTY) == R"({"parent2":{"child3":3}})");
-        CHECK(false == root.dirty());
-        CHECK(false == root.persistDirty());
-
         CHECK(toJson(root, Property::PERSIST) == R"({"parent":{"child2":-2},"parent2":{"child3":3}})");
-        CHECK(false == root.dirty());
-        CHECK(false == root.persistDirty());
-
 
         // change non-persisted node
         prop_child1.set(-1);
-        CHECK(root.dirty());
-        CHECK(false == root.persistDirty());
-        CHECK(toJson(root, Property::DIRTY) == R"({"parent":{"child1":-1}})");
-        CHECK(false == root.dirty());
         CHECK(false == root.persistDirty());
 
         // persisted node
         prop_child3.set(-3);
-        CHECK(root.dirty());
         CHECK(root.persistDirty());
-        CHECK(toJson(root, Property::DIRTY) == R"({"parent2":{"child3":-3}})");
-        CHECK(false == root.dirty());
+        CHECK(toJson(root) == R"({"parent":{"child1":-1,"child2":-2},"parent2":{"child3":-3}})");
         CHECK(root.persistDirty());
         CHECK(toJson(root, Property::PERSIST) == R"({"parent":{"child2":-2},"parent2":{"child3":-3}})");
-        CHECK(false == root.dirty());
         CHECK(false == root.persistDirty());
     }
 
@@ -237,9 +230,9 @@ TEST_SUITE("Property") {
         PropertyInt prop_child1{ &prop_parent, "child1", -1 };
         PropertyInt prop_child2{ &prop_parent, "child2", -2 };
 
-        CHECK(toJson(prop_root, Property::DIRTY) == R"({"parent":{"child1":-1,"child2":-2}})");
-        CHECK(false == prop_root.dirty());
+        CHECK(toJson(prop_root) == R"({"parent":{"child1":-1,"child2":-2}})");
         CHECK(false == prop_root.persistDirty());
+        const auto since = Property::generation();
 
         auto loadJson = [&prop_root] {
             DynamicJsonDocument doc{2048};
@@ -256,19 +249,19 @@ TEST_SUITE("Property") {
 
         // should not have changed as properties haven't been persisted
         CHECK(toJson(prop_root) == R"({"parent":{"child1":-1,"child2":-2}})");
-        CHECK(false == prop_root.dirty());
+        CHECK(prop_root.changed() == since);
         CHECK(false == prop_root.persistDirty());
 
 
         // persist child2
         prop_child2.setPersist();
-        CHECK(false == prop_root.dirty());
+        CHECK(prop_root.changed() == since);
         CHECK(false == prop_root.persistDirty());
 
         // load values (child2 should update)
         loadJson();
         CHECK(toJson(prop_root) == R"({"parent":{"child1":-1,"child2":2}})");
-        CHECK(false == prop_root.dirty());
+        CHECK(prop_root.changed() == since);
         CHECK(false == prop_root.persistDirty());
 
 
@@ -279,4 +272,430 @@ TEST_SUITE("Property") {
         loadJson();
         CHECK(toJson(prop_root) == R"({"parent":{"child1":-1,"child2":2,"bool":true}})");
     }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("find") {
+        PropertyNode root;
+        PropertyNode sys{ &root, "sys" };
+        PropertyNode net{ &sys, "net" };
+        PropertyNode cur{ &net, "cur" };
+        PropertyString address{ &cur, "ipv4Address", "10.0.0.2" };
+        PropertyString dns{ &cur, "ipv4Dns1", "10.0.0.1" };
+        PropertyInt a{ &sys, "a", 1 };
+        PropertyInt ab{ &sys, "ab", 2 };
+
+        CHECK(root.child("sys") == &sys);
+        CHECK(sys.child("a") == &a);
+        CHECK(sys.child("ab") == &ab);
+        CHECK(sys.child("abc") == nullptr);
+        CHECK(sys.child("") == nullptr);
+        CHECK(sys.child("abc", 2) == &ab);
+        CHECK(sys.child("net")->asNode() == &net);
+        CHECK(a.asNode() == nullptr);
+        CHECK(a.parent() == &sys);
+
+        CHECK(root.find("sys.net.cur.ipv4Address") == &address);
+        CHECK(root.find("sys.net.cur.ipv4Dns1") == &dns);
+        CHECK(root.find("sys.net") == &net);
+        CHECK(net.find("cur.ipv4Address") == &address);
+        CHECK(root.find("sys.net.cur.ipv4Address.x") == nullptr);
+        CHECK(root.find("sys.net.missing") == nullptr);
+        CHECK(root.find("sys..net") == nullptr);
+        CHECK(root.find("") == nullptr);
+
+        // index follows children coming and going
+        {
+            PropertyInt aa{ &sys, "aa", 3 };
+            CHECK(root.find("sys.aa") == &aa);
+            CHECK(root.find("sys.ab") == &ab);
+        }
+        CHECK(root.find("sys.aa") == nullptr);
+        CHECK(root.find("sys.ab") == &ab);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("assign") {
+        PropertyNode root;
+        PropertyNode node{ &root, "node" };
+        PropertyInt prop_int{ &node, "int", 1, Property::WRITABLE };
+        PropertyString prop_str{ &node, "str", "string" };
+        PropertyIpAddress prop_ip{ &node, "ip" };
+        const auto since = Property::generation();
+
+        // writable doesn't spread to parents
+        CHECK(prop_int.writable());
+        CHECK(false == node.writable());
+
+        DynamicJsonDocument doc{256};
+        doc["int"] = 2;
+        doc["str"] = "text";
+        doc["ip"] = "192.168.1.10";
+        doc["bad"] = "192.168.1";
+
+        CHECK(prop_int.assign(doc["int"]));
+        CHECK(prop_int.value() == 2);
+        CHECK(root.changed() > since);
+        CHECK(printJson(root, 0, since) == R"({"node":{"int":2}})");
+
+        // same value isn't a change
+        const auto later = Property::generation();
+        CHECK(prop_int.assign(doc["int"]));
+        CHECK(root.changed() == later);
+
+        // mismatched types
+        CHECK(false == prop_int.assign(doc["str"]));
+        CHECK(false == prop_str.assign(doc["int"]));
+        CHECK(false == prop_ip.assign(doc["bad"]));
+        CHECK(false == node.assign(doc["int"]));
+        CHECK(root.changed() == later);
+
+        CHECK(prop_str.assign(doc["str"]));
+        CHECK(prop_str.value() == "text");
+        CHECK(prop_ip.assign(doc["ip"]));
+        CHECK(prop_ip->toString() == "192.168.1.10");
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("printJson") {
+        PropertyNode root;
+        PropertyNode parent{ &root, "parent" };
+        PropertyInt prop_int{ &parent, "int", -1, Property::PERSIST };
+        PropertyFloat prop_float{ &parent, "float", 1.5f };
+        PropertyString prop_str{ &parent, "str", "quote \" here" };
+        PropertyIpAddress prop_ip{ &parent, "ip", IPAddress{192, 168, 1, 2}, Property::PERSIST };
+        PropertyIpAddress prop_unset{ &parent, "unset" };
+        PropertyNode empty{ &root, "empty" };
+        PropertyBool prop_bool{ &root, "bool", true };
+
+        // matches toJson
+        const auto expected = toJson(root);
+        CHECK(expected == R"({"parent":{"int":-1,"float":1.5,"str":"quote \" here","ip":"192.168.1.2","unset":""},"empty":{},"bool":true})");
+        CHECK(root.measureJson() == expected.size());
+        CHECK(printJson(root) == expected);
+        CHECK(root.measureJson(Property::PERSIST) == std::string{R"({"parent":{"int":-1,"ip":"192.168.1.2"}})"}.size());
+
+        // changes since a generation
+        const auto since = Property::generation();
+        CHECK(printJson(root, 0, since) == R"({})");
+        prop_bool.set(false);
+        prop_int.set(2);
+        CHECK(root.measureJson(0, since) == 33);
+        CHECK(printJson(root, 0, since) == R"({"parent":{"int":2},"bool":false})");
+
+        // measuring leaves persist dirty alone, printing clears it
+        CHECK(root.persistDirty());
+        CHECK(root.measureJson(Property::PERSIST) == std::string{R"({"parent":{"int":2,"ip":"192.168.1.2"}})"}.size());
+        CHECK(root.persistDirty());
+        CHECK(printJson(root, Property::PERSIST) == R"({"parent":{"int":2,"ip":"192.168.1.2"}})");
+        CHECK(false == root.persistDirty());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("printJson chunks") {
+        PropertyNode root;
+        PropertyNode parent{ &root, "parent" };
+        PropertyInt prop_int{ &parent, "int", -1 };
+        PropertyString prop_str{ &parent, "str", "quote \" here" };
+        PropertyBool prop_bool{ &root, "bool", true };
+
+        // printed afresh for each chunk, skipping what was already taken
+        std::string chunks;
+        for (;;) {
+            uint8_t buffer[7];
+            PrintBuffer out{buffer, sizeof(buffer), chunks.size()};
+            root.printJson(out);
+            if (0 == out.length()) break;
+            chunks.append(reinterpret_cast<const char*>(buffer), out.length());
+        }
+        CHECK(chunks == printJson(root));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("printMsgPack") {
+        PropertyNode root;
+        PropertyNode parent{ &root, "parent" };
+        PropertyInt prop_int{ &parent, "int", -1, Property::PERSIST };
+        PropertyString prop_str{ &parent, "str", "ab" };
+        PropertyNode empty{ &root, "empty" };
+        PropertyBool prop_bool{ &root, "bool", true };
+
+        // leaves numbered depth first
+        DynamicJsonDocument schema{512};
+        root.toJsonSchema(schema);
+        std::string json;
+        serializeJson(schema, json);
+        CHECK(json == R"({"parent":{"int":0,"str":1},"empty":{},"bool":2})");
+
+        // map of leaf id to value
+        const std::vector<uint8_t> full{ 0x83, 0x00, 0xFF, 0x01, 0xA2, 'a', 'b', 0x02, 0xC3 };
+        CHECK(root.measureMsgPack() == full.size());
+        CHECK(printMsgPack(root) == full);
+        CHECK(printMsgPack(root, Property::PERSIST) == std::vector<uint8_t>{ 0x81, 0x00, 0xFF });
+
+        // ids are stable whatever changed
+        const auto since = Property::generation();
+        CHECK(printMsgPack(root, 0, since) == std::vector<uint8_t>{ 0x80 });
+        prop_bool.set(false);
+        CHECK(printMsgPack(root, 0, since) == std::vector<uint8_t>{ 0x81, 0x02, 0xC2 });
+
+        // printing without clearing leaves persist dirty for another encoding
+        prop_int.set(300);
+        CHECK(root.measureMsgPack(Property::PERSIST) == 5);
+        uint8_t buffer[16];
+        PrintBuffer out{buffer, sizeof(buffer)};
+        CHECK(root.printMsgPack(out, Property::PERSIST, 0, false) == 5);
+        CHECK(std::vector<uint8_t>(buffer, buffer + out.length()) == std::vector<uint8_t>{ 0x81, 0x00, 0xCD, 0x01, 0x2C });
+        CHECK(root.persistDirty());
+        CHECK(printJson(root, Property::PERSIST) == R"({"parent":{"int":300}})");
+        CHECK(false == root.persistDirty());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("generations") {
+        PropertyNode root;
+        PropertyNode parent{ &root, "parent" };
+        PropertyInt prop_int{ &parent, "int", 1 };
+        PropertyBool prop_bool{ &root, "bool", false };
+        CHECK(root.changed() == Property::generation());
+        CHECK(prop_bool.changed() > prop_int.changed());
+
+        // two consumers, each with their own cursor
+        uint32_t first = 0;
+        uint32_t second = 0;
+        CHECK(printJson(root, 0, first) == R"({"parent":{"int":1},"bool":false})");
+        first = Property::generation();
+        CHECK(printJson(root, 0, first) == R"({})");
+
+        prop_int.set(2);
+        CHECK(parent.changed() == prop_int.changed());
+        CHECK(root.changed() == prop_int.changed());
+        CHECK(root.measureJson(0, first) == std::string{R"({"parent":{"int":2}})"}.size());
+        CHECK(printJson(root, 0, first) == R"({"parent":{"int":2}})");
+        first = Property::generation();
+
+        // taking changes doesn't hide them from the other consumer
+        prop_bool.set(true);
+        CHECK(printJson(root, 0, first) == R"({"bool":true})");
+        first = Property::generation();
+        CHECK(printJson(root, 0, second) == R"({"parent":{"int":2},"bool":true})");
+        second = Property::generation();
+
+        // unchanged values don't move on
+        prop_int.set(2);
+        CHECK(root.changed() == second);
+        CHECK(printMsgPack(root, 0, first) == std::vector<uint8_t>{ 0x80 });
+
+        // combined with flags
+        prop_int.set(3);
+        CHECK(printMsgPack(root, 0, first) == std::vector<uint8_t>{ 0x81, 0x00, 0x03 });
+        CHECK(printJson(root, Property::PERSIST, first) == R"({})");
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("changed leaves") {
+        PropertyNode root;
+        PropertyNode a{ &root, "a" };
+        PropertyInt a_x{ &a, "x", 1 };
+        PropertyNode a_b{ &a, "b" };
+        PropertyInt a_b_y{ &a_b, "y", 2 };
+        PropertyInt a_z{ &a, "z", 3 };
+        PropertyNode c{ &root, "c" };
+        PropertyString c_s{ &c, "s", "s" };
+        PropertyBool w{ &root, "w" };
+
+        PropertyNode other;
+        PropertyInt other_x{ &other, "x" };
+        const auto since = Property::generation();
+
+        // changed out of order, printed nested in tree order
+        w.set(true);
+        a_z.set(30);
+        other_x.set(1);
+        c_s.set("t");
+        a_b_y.set(20);
+        a_x.set(10);
+        const std::string expected{R"({"a":{"x":10,"b":{"y":20},"z":30},"c":{"s":"t"},"w":true})"};
+        CHECK(root.measureJson(0, since) == expected.size());
+        CHECK(printJson(root, 0, since) == expected);
+        CHECK(printMsgPack(root, 0, since) == std::vector<uint8_t>{ 0x85, 0x00, 0x0A, 0x01, 0x14, 0x02, 0x1E, 0x03, 0xA1, 't', 0x04, 0xC3 });
+
+        // matches the tree walk (subtrees are walked)
+        CHECK(printJson(a, 0, since) == R"({"x":10,"b":{"y":20},"z":30})");
+
+        // only the latest changes, renumbered as the tree changes
+        const auto later = Property::generation();
+        c_s.set("u");
+        a_b_y.set(21);
+        CHECK(printJson(root, 0, later) == R"({"a":{"b":{"y":21}},"c":{"s":"u"}})");
+        {
+            PropertyInt a_b_v{ &a_b, "v", 5 };
+            CHECK(printJson(root, 0, later) == R"({"a":{"b":{"y":21,"v":5}},"c":{"s":"u"}})");
+            CHECK(printMsgPack(root, 0, later) == std::vector<uint8_t>{ 0x83, 0x01, 0x15, 0x02, 0x05, 0x04, 0xA1, 'u' });
+        }
+        CHECK(printMsgPack(root, 0, later) == std::vector<uint8_t>{ 0x82, 0x01, 0x15, 0x03, 0xA1, 'u' });
+        CHECK(printJson(other, 0, since) == R"({"x":1})");
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("observers") {
+        PropertyNode root;
+        PropertyNode parent{ &root, "parent" };
+        PropertyInt prop_int{ &parent, "int" };
+        PropertyBool prop_bool{ &root, "bool" };
+
+        std::vector<std::string> sync;
+        int deferred = 0;
+        prop_int.observe([&sync](Property& prop) { sync.push_back(prop.name()); });
+        root.observe([&sync](Property& prop) { sync.push_back(std::string{"root "} + prop.name()); });
+        parent.observe([&deferred, &parent](Property& prop) {
+            CHECK(&prop == &parent);
+            ++deferred;
+        }, true);
+
+        // synchronous observers are called as changes are made
+        prop_int.set(1);
+        prop_int.set(1);
+        prop_bool.set(true);
+        prop_int.set(2);
+        CHECK(sync == std::vector<std::string>{ "int", "root int", "root bool", "int", "root int" });
+        CHECK(0 == deferred);
+
+        // deferred are coalesced until the next notification
+        Property::notifyDeferred();
+        CHECK(1 == deferred);
+        Property::notifyDeferred();
+        CHECK(1 == deferred);
+        prop_bool.set(false);
+        Property::notifyDeferred();
+        CHECK(1 == deferred);
+
+        // changes made by an observer are notified next time
+        {
+            PropertyInt prop_other{ &root, "other" };
+            prop_other.observe([&prop_int](Property&) { prop_int.set(3); }, true);
+            prop_other.set(1);
+            Property::notifyDeferred();
+            CHECK(1 == deferred);
+            CHECK(3 == prop_int.value());
+            Property::notifyDeferred();
+            CHECK(2 == deferred);
+        }
+
+        // observers go with their property
+        prop_int.set(4);
+        Property::notifyDeferred();
+        CHECK(3 == deferred);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("PropertyRecordT") {
+        PropertyNode root;
+        PropertyRecordT<TestSchema> record{ &root, "rec", { true, -1, 2, 0.5f } };
+        PropertyInt prop_int{ &root, "int", 1 };
+        CHECK(record.persist());
+        CHECK(record->level == -1);
+
+        // an object of fields
+        const std::string expected{R"({"rec":{"on":true,"level":-1,"count":2,"ratio":0.5},"int":1})"};
+        CHECK(toJson(root) == expected);
+        CHECK(printJson(root) == expected);
+        CHECK(printJson(root, Property::PERSIST) == R"({"rec":{"level":-1,"ratio":0.5}})");
+
+        // unchanged values don't move on
+        const auto since = Property::generation();
+        record.set({ true, -1, 2, 0.5f });
+        CHECK(record.changed() <= since);
+        record.set({ true, -1, 3, 0.5f });
+        CHECK(record.changed() > since);
+        record.set({ false, -1, 3, 0.25f });
+
+        // changes are the whole record, a leaf with a map of fields
+        CHECK(printJson(root, 0, since) == R"({"rec":{"on":false,"level":-1,"count":3,"ratio":0.25}})");
+        const auto msgPack = printMsgPack(root, 0, since);
+        const std::vector<uint8_t> prefix{
+            0x81, 0x00, 0x84,
+            0xA2, 'o', 'n', 0xC2,
+            0xA5, 'l', 'e', 'v', 'e', 'l', 0xFF,
+            0xA5, 'c', 'o', 'u', 'n', 't', 0x03,
+            0xA5, 'r', 'a', 't', 'i', 'o', // float encoding is up to ArduinoJson
+        };
+        REQUIRE(msgPack.size() > prefix.size());
+        CHECK(std::vector<uint8_t>(msgPack.begin(), msgPack.begin() + prefix.size()) == prefix);
+
+        // persisted fields load
+        DynamicJsonDocument doc{256};
+        deserializeJson(doc, R"({"rec":{"on":true,"level":7,"count":9,"ratio":1}})");
+        root.fromJson(doc.as<JsonObject>());
+        CHECK(printJson(root) == R"({"rec":{"on":false,"level":7,"count":3,"ratio":1},"int":1})");
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("PropertyFloatDeadband") {
+        PropertyNode root;
+
+        SUBCASE("absolute") {
+            PropertyFloatDeadband prop{ &root, "power", 100, { 0.5f, 0, 0 } };
+            const auto since = Property::generation();
+
+            CHECK(false == prop.set(100.4f));
+            CHECK(false == prop.set(99.6f));
+            CHECK(root.changed() <= since);
+            CHECK(prop.value() == 100);
+
+            CHECK(prop.set(100.6f));
+            CHECK(root.changed() > since);
+            CHECK(prop.value() == doctest::Approx(100.6f));
+        }
+
+        SUBCASE("relative") {
+            PropertyFloatDeadband prop{ &root, "power", 1000, { 0.5f, 0.01f, 0 } };
+            const auto since = Property::generation();
+
+            CHECK(false == prop.set(1009));
+            CHECK(false == prop.set(991));
+            CHECK(root.changed() <= since);
+            CHECK(prop.set(1011));
+
+            // absolute deadband applies to small values
+            prop.set(10);
+            CHECK(false == prop.set(10.4f));
+            CHECK(prop.set(10.6f));
+        }
+
+        SUBCASE("zero") {
+            PropertyFloatDeadband prop{ &root, "power", 0.3f, { 0.5f, 0.01f, 0 } };
+
+            // to and from zero are taken on, within the deadband
+            CHECK(prop.set(0));
+            CHECK(prop.value() == 0);
+            CHECK(false == prop.set(0));
+            CHECK(prop.set(0.2f));
+            CHECK(prop.value() == doctest::Approx(0.2f));
+            CHECK(false == prop.set(0.4f));
+        }
+
+        SUBCASE("slow drift") {
+            PropertyFloatDeadband prop{ &root, "voltage", 120, { 0.5f, 0, 0 } };
+            float value = 120;
+            int changes = 0;
+            for (int i = 0; i < 20; ++i) {
+                value += 0.2f;
+                if (prop.set(value)) ++changes;
+            }
+            CHECK(changes == 6);
+            CHECK(prop.value() == doctest::Approx(123.6f));
+        }
+
+        SUBCASE("quantum") {
+            PropertyFloatDeadband prop{ &root, "power", 0, { 0, 0, 0.25f } };
+            const auto since = Property::generation();
+
+            CHECK(false == prop.set(0.1f));
+            CHECK(root.changed() <= since);
+            CHECK(prop.set(12.3f));
+            CHECK(prop.value() == 12.25f);
+            CHECK(false == prop.set(12.2f));
+            CHECK(printJson(root, 0, since) == R"({"power":12.25})");
+        }
+    }
 }
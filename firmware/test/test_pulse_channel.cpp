@@ -0,0 +1,240 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test pulse channel
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "cycle_clock.h"
+#include "hlw8012.h"
+#include "pulse_channel.h"
+
+namespace {
+    /// pass through frequency
+    uint32_t identity(uint32_t value) { return value; }
+
+    /// feed a falling edge every periodMicros until a value is produced
+    /// @returns time of the edge which produced the value
+    uint64_t countUntilValue(PulseChannel& channel, uint64_t& time, uint32_t periodMicros) {
+        for (int i = 0; i < 1000; ++i) {
+            time += periodMicros;
+            if (channel.edge(time, false)) return time;
+        }
+        FAIL("no value produced");
+        return time;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("PulseChannel") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("width") {
+        PulseChannel channel{ identity };
+        CHECK(channel.mode() == PulseChannel::Mode::WIDTH);
+        CHECK(channel.value() == 0);
+
+        // falling edge without a rising edge
+        CHECK(false == channel.edge(100, false));
+
+        // 50% duty cycle => 1381 us pulse is a 2762 us period
+        CHECK(false == channel.edge(1000, true));
+        CHECK(channel.edge(2381, false));
+        CHECK(channel.value() == 362056); // mHz
+
+        // pulse not yet overdue
+        CHECK(false == channel.idle(2381 + PulseChannel::GATE_MAX_MICROS - 1));
+        CHECK(channel.value() == 362056);
+
+        // overdue pulse, frequency is at most 1/elapsed
+        CHECK(channel.idle(2381 + PulseChannel::GATE_MAX_MICROS));
+        CHECK(channel.value() == 200); // mHz
+        CHECK(false == channel.idle(2381 + PulseChannel::GATE_MAX_MICROS));
+
+        // pulses stopped (load off)
+        CHECK(channel.idle(2381 + PulseChannel::IDLE_ZERO_MICROS));
+        CHECK(channel.value() == 0);
+        CHECK(false == channel.idle(0x80000000));
+
+        // measures again once pulses return
+        CHECK(false == channel.edge(0x80000000, true));
+        CHECK(channel.edge(0x80000000 + 1381, false));
+        CHECK(channel.value() == 362056);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("width - cycles") {
+        // 80 MHz CPU cycles resolve fractions of a microsecond
+        PulseChannel channel{ identity, 80 };
+        CHECK(channel.ticksPerMicro() == 80);
+
+        CHECK(false == channel.edge(80000, true));
+        CHECK(channel.edge(80000 + 50 * 80 + 40, false)); // 50.5 us
+        CHECK(channel.value() == 9900990); // mHz
+
+        CHECK(false == channel.edge(80000, true));
+        CHECK(channel.edge(80000 + 50 * 80, false)); // 50 us
+        CHECK(channel.value() == 10000000); // mHz
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("count - fast pulses") {
+        PulseChannel channel{ identity };
+        channel.setMode(PulseChannel::Mode::COUNT);
+
+        // rising edges are ignored, first falling edge opens the gate
+        uint64_t time = 12345;
+        CHECK(false == channel.edge(time, true));
+        CHECK(false == channel.edge(time, false));
+
+        // 100 Hz => minimum gate window
+        const auto closed = countUntilValue(channel, time, 10000);
+        CHECK(closed == 12345 + PulseChannel::GATE_MIN_MICROS);
+        CHECK(channel.value() == 100000); // mHz
+
+        // following window continues from last edge
+        CHECK(countUntilValue(channel, time, 8000) == closed + 256000);
+        CHECK(channel.value() == 125000);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("count - slow pulses") {
+        PulseChannel channel{ identity };
+        channel.setMode(PulseChannel::Mode::COUNT);
+
+        // ~1 W standby => 4.2 s between CF pulses
+        uint64_t time = 0;
+        CHECK(false == channel.edge(time, false));
+        const auto closed = countUntilValue(channel, time, 4200000);
+        CHECK(closed == 2 * 4200000); // needs two intervals to exceed GATE_MAX_MICROS
+        CHECK(channel.value() == 238); // mHz
+
+        // steady reading, idle doesn't lower the value when pulses are on time
+        for (int i = 0; i < 10; ++i) {
+            CHECK(false == channel.idle(time + 4100000));
+            countUntilValue(channel, time, 4200000);
+            CHECK(channel.value() == 238);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("count - idle") {
+        PulseChannel channel{ identity };
+        channel.setMode(PulseChannel::Mode::COUNT);
+
+        uint64_t time = 0;
+        CHECK(false == channel.edge(time, false));
+        countUntilValue(channel, time, 1000000);
+        CHECK(channel.value() == 1000);
+
+        // pulses stop, value decays with time since the last edge
+        CHECK(false == channel.idle(time + PulseChannel::GATE_MAX_MICROS - 1));
+        CHECK(channel.idle(time + 8000000));
+        CHECK(channel.value() == 125);
+        CHECK(false == channel.idle(time + 7000000)); // doesn't raise the value
+        CHECK(channel.value() == 125);
+
+        // then reads as zero
+        CHECK(channel.idle(time + PulseChannel::IDLE_ZERO_MICROS));
+        CHECK(channel.value() == 0);
+        CHECK(false == channel.idle(time + 2 * PulseChannel::IDLE_ZERO_MICROS));
+
+        // gate restarts with the next edge
+        time += 3 * PulseChannel::IDLE_ZERO_MICROS;
+        CHECK(false == channel.edge(time, false));
+        countUntilValue(channel, time, 500000);
+        CHECK(channel.value() == 2000);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("count - conversion") {
+        PulseChannel channel{ hlw8012::milliWattsFromFrequency };
+        channel.setMode(PulseChannel::Mode::COUNT);
+
+        // 1 W standby load
+        const auto period = static_cast<uint32_t>(1000000 * hlw8012::WATTS_PER_HZ);
+        uint64_t time = 0;
+        channel.edge(time, false);
+        countUntilValue(channel, time, period);
+        CHECK(channel.value() >= 995); // mHz resolution at 0.24 Hz
+        CHECK(channel.value() <= 1001);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("diagnostics") {
+        PulseChannel channel{ identity };
+        CHECK(channel.edges() == 0);
+        CHECK(channel.rejected() == 0);
+        CHECK(channel.jitterMax() == 0);
+
+        // glitch is rejected, retaining the last value
+        CHECK(false == channel.edge(1000, true));
+        CHECK(channel.edge(2000, false));
+        CHECK(false == channel.edge(3000, true));
+        CHECK(false == channel.edge(3002, false));
+        CHECK(channel.value() == 500000);
+        CHECK(channel.edges() == 4);
+        CHECK(channel.rejected() == 1);
+        CHECK(channel.accepted() == 1);
+
+        // falling edges 2000, 3002, 4002, 5010 => intervals 1002, 1000, 1008
+        CHECK(channel.jitterMax() == 0); // single interval
+        channel.edge(4002, false);
+        CHECK(channel.jitterMax() == 2);
+        channel.edge(5010, false);
+        CHECK(channel.jitterMax() == 8);
+        channel.edge(6010, false);
+        CHECK(channel.jitterMax() == 8); // retains maximum
+
+        // period step isn't jitter
+        channel.edge(7510, false);
+        CHECK(channel.jitterMax() == 8);
+
+        // new window
+        channel.resetJitter();
+        CHECK(channel.jitterMax() == 0);
+        channel.edge(9013, false);
+        CHECK(channel.jitterMax() == 3);
+
+        // count mode glitches
+        channel.setMode(PulseChannel::Mode::COUNT);
+        CHECK(false == channel.edge(10000, false));
+        CHECK(false == channel.edge(10005, false));
+        CHECK(channel.rejected() == 2);
+        CHECK(channel.edges() == 11);
+        CHECK(channel.accepted() == 7); // every falling edge but the glitches
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("CycleClock") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("extend") {
+        CycleClock clock{0xFFFFFF00};
+        const auto start = clock.last();
+        CHECK(clock.extend(0xFFFFFF00) == start);
+
+        // wraps around
+        CHECK(clock.extend(0x00000100) == start + 0x200);
+        CHECK(clock.extend(0x80000000) == start + 0x80000100);
+        CHECK(clock.extend(0xFFFFFF00) == start + 0x100000000);
+        CHECK(clock.extend(0x00000100) == start + 0x100000200);
+
+        // slightly out of order
+        CHECK(clock.extend(0x00000000) == start + 0x100000100);
+        CHECK(clock.extend(0xFFFFFFF0) == start + 0x1000000F0);
+        CHECK(clock.extend(0x00000200) == start + 0x100000300);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("reset") {
+        // counts from before the reset remain positive
+        CycleClock clock;
+        clock.reset(0x10);
+        const auto start = clock.last();
+        CHECK(clock.extend(0xFFFFFFF0) == start - 0x20);
+        CHECK(clock.extend(0x20) == start + 0x10);
+    }
+}
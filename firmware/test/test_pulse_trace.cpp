@@ -0,0 +1,132 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test raw pulse trace capture
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "pulse_channel.h"
+#include "pulse_trace.h"
+#include <cstring>
+#include <vector>
+
+namespace {
+    /// pass through frequency
+    uint32_t identity(uint32_t value) { return value; }
+
+    /// download blob in chunks
+    std::vector<uint8_t> download(const PulseTrace& trace, size_t chunk) {
+        std::vector<uint8_t> blob;
+        uint8_t buffer[64];
+        for (;;) {
+            const auto len = trace.read(blob.size(), buffer, chunk);
+            if (0 == len) break;
+            blob.insert(blob.end(), buffer, buffer + len);
+        }
+        return blob;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("PulseTrace") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("capture") {
+        PulseTrace trace;
+        CHECK(false == trace.capturing());
+        CHECK(trace.size() == sizeof(PulseTrace::Header));
+
+        CHECK(false == trace.start(0, 80, 0));
+        CHECK(false == trace.start(PulseTrace::CAPACITY + 1, 80, 0));
+
+        CHECK(trace.start(3, 80, 1));
+        CHECK(trace.capturing());
+        trace.add(100, 13, false);
+        trace.add(200, 12, true);
+        trace.add(300, 13, false);
+        CHECK(false == trace.capturing());
+        trace.add(400, 12, false); // ignored once complete
+        CHECK(trace.count() == 3);
+        CHECK(trace.size() == sizeof(PulseTrace::Header) + 3 * sizeof(PulseTrace::Record));
+
+        // restart discards previous trace
+        CHECK(trace.start(10, 80, 0));
+        CHECK(trace.count() == 0);
+        CHECK(trace.capturing());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("download") {
+        PulseTrace trace;
+        trace.start(20, 160, 0);
+        for (uint32_t i = 0; i < 20; ++i) trace.add(1000 * i, (i & 1) ? 12 : 13, 0 != (i & 2));
+        trace.setOverflows(2);
+
+        const auto blob = download(trace, 64);
+        CHECK(blob.size() == trace.size());
+
+        // odd chunk sizes straddle the header and records
+        CHECK(download(trace, 7) == blob);
+        CHECK(download(trace, 1) == blob);
+
+        PulseTrace::Header header;
+        memcpy(&header, blob.data(), sizeof(header));
+        CHECK(header.magic == PulseTrace::MAGIC);
+        CHECK(header.version == PulseTrace::VERSION);
+        CHECK(header.ticksPerMicro == 160);
+        CHECK(header.count == 20);
+        CHECK(header.overflows == 2);
+
+        PulseTrace::Record record;
+        memcpy(&record, blob.data() + sizeof(header) + 5 * sizeof(record), sizeof(record));
+        CHECK(record.cycles == 5000);
+        CHECK(record.pin == 12);
+        CHECK(record.rising == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("download holds trace") {
+        PulseTrace trace;
+        trace.start(2, 80, 0);
+        trace.add(100, 13, true);
+        trace.add(200, 13, false);
+
+        {
+            PulseTrace::Reader reader{trace};
+            CHECK(trace.reading());
+            CHECK(reader.size() == sizeof(PulseTrace::Header) + 2 * sizeof(PulseTrace::Record));
+
+            // new capture would reset count part way through the download
+            CHECK(false == trace.start(10, 80, 0));
+            CHECK(trace.count() == 2);
+        }
+
+        CHECK(false == trace.reading());
+        CHECK(trace.start(10, 80, 0));
+        CHECK(trace.count() == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("replay") {
+        // capture 1 kHz CF pulses, then replay through a channel
+        PulseTrace trace;
+        trace.start(8, 1, static_cast<uint8_t>(PulseChannel::Mode::WIDTH));
+        for (uint32_t t = 0; trace.capturing(); t += 500) trace.add(t, 13, 0 == (t % 1000));
+
+        const auto blob = download(trace, 64);
+        PulseTrace::Header header;
+        memcpy(&header, blob.data(), sizeof(header));
+
+        PulseChannel channel{ identity, header.ticksPerMicro };
+        int values = 0;
+        for (size_t i = 0; i < header.count; ++i) {
+            PulseTrace::Record record;
+            memcpy(&record, blob.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+            if (channel.edge(record.cycles, 0 != record.rising)) ++values;
+        }
+        CHECK(values == 4);
+        CHECK(channel.value() == 1000000); // mHz
+    }
+}
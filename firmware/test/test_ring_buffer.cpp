@@ -0,0 +1,80 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test ring buffer
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "ring_buffer.h"
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("RingBufferT") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("push + pop") {
+        RingBufferT<int, 4> ring;
+        CHECK(ring.capacity() == 3);
+        CHECK(ring.empty());
+        CHECK(ring.size() == 0);
+
+        int value = -1;
+        CHECK(false == ring.pop(value));
+        CHECK(value == -1);
+
+        CHECK(ring.push(1));
+        CHECK(ring.push(2));
+        CHECK(ring.push(3));
+        CHECK(false == ring.push(4)); // full
+        CHECK(ring.size() == 3);
+
+        CHECK(ring.pop(value));
+        CHECK(value == 1);
+        CHECK(ring.size() == 2);
+
+        CHECK(ring.push(4));
+        CHECK(ring.pop(value));
+        CHECK(value == 2);
+        CHECK(ring.pop(value));
+        CHECK(value == 3);
+        CHECK(ring.pop(value));
+        CHECK(value == 4);
+        CHECK(false == ring.pop(value));
+        CHECK(ring.empty());
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("wrap around") {
+        RingBufferT<int, 8> ring;
+
+        int next = 0;
+        int expected = 0;
+        for (int round = 0; round < 100; ++round) {
+            // fill in varying amounts to exercise each slot
+            const int count = (round % 7) + 1;
+            for (int j = 0; j < count; ++j) CHECK(ring.push(next++));
+            CHECK(ring.size() == count);
+
+            int value = -1;
+            while (ring.pop(value)) CHECK(value == expected++);
+        }
+        CHECK(expected == next);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("clear") {
+        RingBufferT<int, 4> ring;
+        ring.push(1);
+        ring.push(2);
+        CHECK(ring.size() == 2);
+
+        ring.clear();
+        CHECK(ring.empty());
+
+        int value = -1;
+        CHECK(ring.push(3));
+        CHECK(ring.pop(value));
+        CHECK(value == 3);
+    }
+}
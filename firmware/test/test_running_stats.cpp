@@ -0,0 +1,51 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test incremental statistics
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "running_stats.h"
+#include <initializer_list>
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("RunningStats") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("empty") {
+        RunningStats stats;
+        CHECK(stats.count() == 0);
+        CHECK(stats.mean() == 0);
+        CHECK(stats.variance() == 0);
+        CHECK(stats.stddev() == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("values") {
+        RunningStats stats;
+        for (const double v : { 2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0 }) stats.add(v);
+        CHECK(stats.count() == 8);
+        CHECK(stats.min() == 2);
+        CHECK(stats.max() == 9);
+        CHECK(stats.mean() == doctest::Approx(5));
+        CHECK(stats.stddev() == doctest::Approx(2));
+
+        stats.reset();
+        CHECK(stats.count() == 0);
+        stats.add(-3);
+        CHECK(stats.min() == -3);
+        CHECK(stats.max() == -3);
+        CHECK(stats.stddev() == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("large offset") {
+        // mains voltage, small variations on a large value
+        RunningStats stats;
+        for (int i = 0; i < 900; ++i) stats.add(120000.0 + ((i & 1) ? 0.5 : -0.5));
+        CHECK(stats.mean() == doctest::Approx(120000));
+        CHECK(stats.stddev() == doctest::Approx(0.5));
+    }
+}
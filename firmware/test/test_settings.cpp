@@ -8,7 +8,11 @@ Licensed under the MIT License. Refer to LICENSE file in the project root. */
 
 //- includes
 #include "doctest_ext.h"
+#include "cadence.h"
+#include "overpower.h"
+#include "pulse_trace.h"
 #include "settings.h"
+#include <memory>
 
 /////////////////////////////////////////////////////////////////////////////
 TEST_SUITE("Settings") {
@@ -24,6 +28,347 @@ TEST_SUITE("Settings") {
         }
     }
 
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("changes notified") {
+        Settings settings;
+        settings.begin();
+
+        int notified = 0;
+        settings.onChangedProperties([&notified](PropertyNode&) { ++notified; });
+        settings.tick();
+        CHECK(0 == notified);
+
+        // several changes, one notification on the next tick
+        CHECK(settings.setRelay(true));
+        DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+        param["path"] = "test.int";
+        param["value"] = 43; // differs from the default (42)
+        DynamicJsonDocument resultDoc{256};
+        const auto since = Property::generation();
+        CHECK(settings.call("set", param.as<JsonObject>(), resultDoc) == JsonRpcError::NO_ERROR);
+        CHECK(settings.propRoot().changed() > since);
+        CHECK(0 == notified);
+        settings.tick();
+        CHECK(1 == notified);
+        settings.tick();
+        CHECK(1 == notified);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - events") {
+        Settings settings;
+
+        // toggle a load every 10 s (more events than are held)
+        auto& steps = settings.steps();
+        uint32_t now = 1600000000;
+        for (int i = 0; i < 40; ++i) {
+            for (int s = 0; s < 10; ++s) steps.add((i & 1) ? 0 : 100, now++);
+        }
+        const auto end = steps.end();
+        REQUIRE(end == 39);
+
+        DynamicJsonDocument resultDoc{Settings::JSON_STATE_SIZE};
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            param.set("invalid");
+
+            const auto error = settings.call("events", param.as<JsonVariant>(), resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Expected object");
+        }
+        {
+            // most recent events
+            const auto error = settings.call("events", JsonObject{}, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc["start"].as<uint32_t>() == end - Settings::EVENTS_PAGE_SIZE);
+            CHECK(resultDoc["next"].as<uint32_t>() == end);
+            CHECK(resultDoc["end"].as<uint32_t>() == end);
+            CHECK(resultDoc["events"].size() == Settings::EVENTS_PAGE_SIZE);
+
+            const auto last = resultDoc["events"][Settings::EVENTS_PAGE_SIZE - 1];
+            CHECK(last["time"].as<uint32_t>() == 1600000000 + 390);
+            CHECK(last["duration"].as<uint32_t>() == 10);
+            CHECK(last["before"].as<float>() == doctest::Approx(100));
+            CHECK(last["after"].as<float>() == doctest::Approx(0));
+        }
+        {
+            // resume from a sequence number
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["start"] = end - 2;
+            obj["count"] = 10;
+
+            const auto error = settings.call("events", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc["start"].as<uint32_t>() == end - 2);
+            CHECK(resultDoc["next"].as<uint32_t>() == end);
+            CHECK(resultDoc["events"].size() == 2);
+            CHECK(resultDoc["events"][0]["after"].as<float>() == doctest::Approx(100));
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - schema") {
+        Settings settings;
+
+        DynamicJsonDocument resultDoc{Settings::JSON_STATE_SIZE};
+        CHECK(settings.call("schema", JsonVariant{}, resultDoc) == JsonRpcError::NO_ERROR);
+        REQUIRE(resultDoc["test"]["int"].is<int>());
+        REQUIRE(resultDoc["power"].is<int>());
+        CHECK(resultDoc["test"]["int"] != resultDoc["power"]);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - get/set") {
+        Settings settings;
+
+        DynamicJsonDocument resultDoc{1024};
+        auto call = [&settings, &resultDoc](const char* method, const char* path, int value) {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            if (path) obj["path"] = path;
+            obj["value"] = value;
+            return settings.call(method, obj, resultDoc);
+        };
+
+        {
+            const auto error = settings.call("get", JsonVariant{}, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Expected object");
+        }
+        {
+            CHECK(call("get", nullptr, 0) == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Missing path");
+        }
+        {
+            CHECK(call("get", "sys.missing", 0) == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Unknown path");
+        }
+        {
+            CHECK(call("get", "sys.meter.mode", 0) == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc.as<std::string>() == "width");
+
+            CHECK(call("get", "test", 0) == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc["int"].as<int>() == 42);
+        }
+        {
+            // only writable properties may be set
+            CHECK(call("set", "relay", 1) == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Read only");
+            CHECK(call("set", "test", 1) == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Read only");
+
+            const auto since = Property::generation();
+            CHECK(call("set", "test.int", 7) == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc.as<bool>());
+            CHECK(settings.propRoot().changed() > since);
+
+            CHECK(call("get", "test.int", 0) == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc.as<int>() == 7);
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            param["path"] = "test.int";
+            param["value"] = "seven";
+            CHECK(settings.call("set", param.as<JsonObject>(), resultDoc) == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid value");
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - history") {
+        std::unique_ptr<Settings> settings{ new Settings };
+
+        // changing values (until the oldest samples are dropped)
+        auto& history = settings->history();
+        uint32_t end = 0;
+        for (; 0 == history.begin(0); ++end) history.add(float(end % 1000), 120);
+        const auto begin = history.begin(0);
+
+        DynamicJsonDocument resultDoc{Settings::JSON_STATE_SIZE};
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            param.set("invalid");
+
+            const auto error = settings->call("history", param.as<JsonVariant>(), resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Expected object");
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["level"] = 3;
+
+            const auto error = settings->call("history", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid level");
+        }
+        {
+            // most recent samples
+            const auto error = settings->call("history", JsonObject{}, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc["interval"].as<int>() == 1);
+            CHECK(resultDoc["start"].as<uint32_t>() == end - Settings::HISTORY_PAGE_SIZE);
+            CHECK(resultDoc["next"].as<uint32_t>() == end);
+            CHECK(resultDoc["end"].as<uint32_t>() == end);
+            CHECK(resultDoc["power"].size() == Settings::HISTORY_PAGE_SIZE);
+            CHECK(resultDoc["power"][0].as<uint32_t>() == ((end - Settings::HISTORY_PAGE_SIZE) % 1000) * 10);
+            CHECK(resultDoc["voltage"][99].as<int>() == 1200);
+        }
+        {
+            // page from before the oldest held sample
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["start"] = begin - 1;
+            obj["count"] = 10;
+
+            const auto error = settings->call("history", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc["start"].as<uint32_t>() == begin);
+            CHECK(resultDoc["next"].as<uint32_t>() == begin + 10);
+            CHECK(resultDoc["power"].size() == 10);
+            CHECK(resultDoc["power"][0].as<uint32_t>() == (begin % 1000) * 10);
+        }
+        {
+            // minutes
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["level"] = 1;
+
+            const auto error = settings->call("history", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc["interval"].as<int>() == 60);
+            CHECK(resultDoc["start"].as<int>() == 0);
+            CHECK(resultDoc["next"].as<uint32_t>() == end / 60);
+            CHECK(resultDoc["power"][0].as<int>() == 295);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - meter") {
+        Settings settings;
+        CHECK(settings.meterMode() == "width");
+
+        int onMeterCalled = 0;
+        settings.onMeter([&onMeterCalled]() { onMeterCalled++; });
+
+        DynamicJsonDocument resultDoc{1024};
+        {
+            const auto error = settings.call("meter", JsonObject{}, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Expected object");
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["mode"] = "invalid";
+
+            const auto error = settings.call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid mode");
+            CHECK(settings.meterMode() == "width");
+            CHECK(onMeterCalled == 0);
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["mode"] = "count";
+
+            const auto error = settings.call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc.as<bool>() == true);
+            CHECK(settings.meterMode() == "count");
+            CHECK(onMeterCalled == 1);
+        }
+
+        // publishing intervals
+        CHECK(settings.meterIntervalMin() == Cadence::DEFAULT_MIN_MILLIS);
+        CHECK(settings.meterIntervalMax() == Cadence::DEFAULT_MAX_MILLIS);
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["intervalMin"] = 50;
+
+            const auto error = settings.call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid intervalMin");
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["intervalMin"] = 10000;
+
+            const auto error = settings.call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid intervalMax"); // below new minimum
+            CHECK(settings.meterIntervalMin() == Cadence::DEFAULT_MIN_MILLIS);
+            CHECK(onMeterCalled == 1);
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["intervalMin"] = 250;
+            obj["intervalMax"] = 10000;
+
+            const auto error = settings.call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(settings.meterIntervalMin() == 250);
+            CHECK(settings.meterIntervalMax() == 10000);
+            CHECK(settings.meterMode() == "count");
+            CHECK(onMeterCalled == 2);
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - meter windows") {
+        std::unique_ptr<Settings> settings{ new Settings };
+        CHECK(settings->statsWindow(0).seconds() == 10);
+        CHECK(settings->statsWindow(1).seconds() == 60);
+        CHECK(settings->statsWindow(2).seconds() == 900);
+
+        DynamicJsonDocument resultDoc{1024};
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["mode"] = "count";
+            auto windows = obj.createNestedArray("windows");
+            windows.add(5);
+            windows.add(0);
+            windows.add(300);
+
+            const auto error = settings->call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid windows");
+            CHECK(settings->meterMode() == "width"); // nothing applied
+            CHECK(settings->statsWindow(0).seconds() == 10);
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            auto windows = obj.createNestedArray("windows");
+            windows.add(5);
+            windows.add(30);
+
+            const auto error = settings->call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid windows");
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            auto windows = obj.createNestedArray("windows");
+            windows.add(5);
+            windows.add(30);
+            windows.add(300);
+
+            const auto error = settings->call("meter", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(settings->statsWindow(0).seconds() == 5);
+            CHECK(settings->statsWindow(1).seconds() == 30);
+            CHECK(settings->statsWindow(2).seconds() == 300);
+        }
+    }
+
     /////////////////////////////////////////////////////////////////////////
     TEST_CASE("call - network") {
         Settings settings;
@@ -222,4 +567,130 @@ TEST_SUITE("Settings") {
             CHECK(relayState == false);
         }
     }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - protect") {
+        std::unique_ptr<Settings> settings{ new Settings };
+        CHECK(settings->protectLimit() == 0);
+        CHECK(false == settings->protectFault());
+
+        int onProtectCalled = 0;
+        settings->onProtect([&onProtectCalled]() { onProtectCalled++; });
+        bool relayState = false;
+        settings->onRelay([&relayState](bool state) { relayState = state; });
+
+        DynamicJsonDocument resultDoc{1024};
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["limit"] = -1;
+
+            const auto error = settings->call("protect", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid limit");
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["limit"] = 1500;
+            obj["inrush"] = Overpower::INRUSH_MAX_MILLIS + 1;
+
+            const auto error = settings->call("protect", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid inrush");
+            CHECK(settings->protectLimit() == 0);
+            CHECK(onProtectCalled == 0);
+        }
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["limit"] = 1500;
+            obj["inrush"] = 200;
+
+            const auto error = settings->call("protect", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(settings->protectLimit() == 1500);
+            CHECK(settings->protectInrush() == 200);
+            CHECK(onProtectCalled == 1);
+        }
+
+        // trip latches fault, opening the relay and blocking it closing
+        CHECK(settings->setRelay(true));
+        settings->tripProtect(1800);
+        CHECK(settings->protectFault());
+        CHECK(false == settings->relay());
+        CHECK(false == relayState);
+
+        DynamicJsonDocument paramsDoc{1024};
+        auto params = paramsDoc.to<JsonVariant>();
+        params.set(true);
+        {
+            const auto error = settings->call("relay", params, resultDoc);
+            CHECK(error == JsonRpcError::FAULT);
+            CHECK(false == settings->relay());
+        }
+
+        // clear
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            auto obj = param.to<JsonObject>();
+            obj["clear"] = true;
+
+            const auto error = settings->call("protect", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(false == settings->protectFault());
+            CHECK(settings->protectLimit() == 1500);
+        }
+        {
+            const auto error = settings->call("relay", params, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(settings->relay());
+        }
+
+        DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
+        settings->toJson(doc);
+        CHECK(doc["protect"]["trips"].as<unsigned>() == 1);
+        CHECK(doc["protect"]["tripPower"].as<float>() == 1800);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("call - trace") {
+        Settings settings;
+
+        DynamicJsonDocument resultDoc{1024};
+        DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+        auto obj = param.to<JsonObject>();
+        {
+            obj["count"] = PulseTrace::CAPACITY + 1;
+            const auto error = settings.call("trace", obj, resultDoc);
+            CHECK(error == JsonRpcError::INVALID_PARAMS);
+            CHECK(resultDoc.as<std::string>() == "Invalid count");
+        }
+
+        // without a capture handler
+        obj["count"] = 100;
+        {
+            const auto error = settings.call("trace", obj, resultDoc);
+            CHECK(error == JsonRpcError::INTERNAL_ERROR);
+            CHECK(resultDoc.as<std::string>() == "Trace unavailable");
+        }
+
+        unsigned traceCount = 0;
+        bool busy = false;
+        settings.onTrace([&traceCount, &busy](unsigned count) { traceCount = count; return !busy; });
+        {
+            const auto error = settings.call("trace", obj, resultDoc);
+            CHECK(error == JsonRpcError::NO_ERROR);
+            CHECK(resultDoc.as<bool>() == true);
+            CHECK(traceCount == 100);
+        }
+
+        // capture can't start (e.g. being downloaded)
+        busy = true;
+        {
+            const auto error = settings.call("trace", obj, resultDoc);
+            CHECK(error == JsonRpcError::BUSY);
+            CHECK(resultDoc.as<std::string>() == "Trace busy");
+        }
+    }
 }
@@ -0,0 +1,315 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test smart plug metering against simulated HLW8012 pulses
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "hlw8012.h"
+#include "hlw8012_sim.h"
+#include "print_buffer.h"
+#include "settings.h"
+#include "smartplug.h"
+#include <chrono>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+
+namespace {
+    /// SmartPlug and Settings driven by a simulated HLW8012
+    struct SimPlug {
+        Hlw8012Sim                  sim;
+        std::unique_ptr<Settings>   settings{ new Settings };
+        std::unique_ptr<SmartPlug>  plug{ new SmartPlug{*settings} };
+
+        SimPlug() {
+            settings->begin();
+            plug->begin();
+        }
+
+        /// run main loop for a period of simulated time
+        void run(uint32_t millis, uint32_t tickMicros = 1000) {
+            sim.run(millis, [this]() {
+                settings->tick();
+                plug->tick();
+            }, tickMicros);
+        }
+
+        /// retrieve published state
+        float state(const char* name) {
+            DynamicJsonDocument doc{2 * Settings::JSON_STATE_SIZE};
+            settings->toJson(doc);
+            return doc[name].as<float>();
+        }
+        float state(const char* node, const char* name) {
+            DynamicJsonDocument doc{2 * Settings::JSON_STATE_SIZE};
+            settings->toJson(doc);
+            return doc[node][name].as<float>();
+        }
+
+        /// edges dropped by the ISRs
+        unsigned overflows() {
+            DynamicJsonDocument doc{2 * Settings::JSON_STATE_SIZE};
+            settings->toJson(doc);
+            return doc["sys"]["meter"]["overflows"].as<unsigned>();
+        }
+
+        /// change metering mode
+        void setMode(const char* mode) {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            param["mode"] = mode;
+            DynamicJsonDocument result{256};
+            CHECK(settings->call("meter", param.as<JsonObject>(), result) == JsonRpcError::NO_ERROR);
+        }
+    };
+
+    /// unwrap a downloaded PulseTrace into edges relative to the first
+    Hlw8012Sim::Edges traceEdges(const PulseTrace& trace) {
+        std::vector<uint8_t> blob(trace.size());
+        trace.read(0, blob.data(), blob.size());
+
+        PulseTrace::Header header;
+        memcpy(&header, blob.data(), sizeof(header));
+
+        Hlw8012Sim::Edges edges;
+        uint32_t first = 0;
+        uint64_t last = 0;
+        for (size_t i = 0; i < header.count; ++i) {
+            PulseTrace::Record record;
+            memcpy(&record, blob.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+            if (0 == i) first = record.cycles;
+
+            // CCOUNT wraps, edges are much closer than a wrap period
+            const uint64_t cycles = last + uint32_t(record.cycles - first - uint32_t(last));
+            edges.push_back({ cycles, record.pin, 0 != record.rising });
+            last = cycles;
+        }
+        return edges;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("Hlw8012Sim") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("pulse trains") {
+        Hlw8012Sim sim;
+        sim.setPower(100);
+        sim.setVoltage(230);
+
+        int ticks = 0;
+        sim.run(10000, [&ticks]() { ++ticks; });
+        CHECK(ticks == 10000);
+
+        // two edges per period
+        const auto expected = 2 * 10 * (100 / hlw8012::WATTS_PER_HZ + 230 / hlw8012::VOLTS_PER_HZ);
+        CHECK(double(sim.edges()) == doctest::Approx(expected).epsilon(0.001));
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("SmartPlug") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("accuracy - width") {
+        SimPlug sp;
+        sp.sim.setVoltage(230);
+
+        for (const double watts : { 5.0, 60.0, 500.0, 2000.0 }) {
+            sp.sim.setPower(watts);
+            sp.run(6000);
+            CHECK(sp.state("power") == doctest::Approx(watts).epsilon(0.015));
+            CHECK(sp.state("voltage") == doctest::Approx(230).epsilon(0.005));
+        }
+        CHECK(sp.overflows() == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("accuracy - count") {
+        SimPlug sp;
+        sp.setMode("count");
+        sp.sim.setVoltage(120);
+
+        for (const double watts : { 10.0, 100.0, 1000.0 }) {
+            sp.sim.setPower(watts);
+            sp.run(10000);
+            CHECK(sp.state("power") == doctest::Approx(watts).epsilon(0.015));
+            CHECK(sp.state("voltage") == doctest::Approx(120).epsilon(0.005));
+        }
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("step published promptly") {
+        SimPlug sp;
+        sp.sim.setVoltage(230);
+        sp.sim.setPower(100);
+        sp.run(20000);
+        CHECK(sp.state("power") == doctest::Approx(100).epsilon(0.015));
+
+        // cadence has backed off (5 s), a step is still published within
+        // a couple of minimum intervals (first reading may straddle the step)
+        sp.sim.setPower(1500);
+        sp.run(300);
+        CHECK(sp.state("power") == doctest::Approx(1500).epsilon(0.015));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("energy") {
+        SimPlug sp;
+        sp.sim.setVoltage(230);
+        sp.sim.setPower(1000);
+        sp.run(36000);
+        CHECK(sp.state("energy", "total") == doctest::Approx(10).epsilon(0.03)); // published each second
+
+        // every pulse is accounted for
+        double total = 0;
+        sp.plug->onPersistEnergy([&total](const JsonDocument& doc) {
+            total = doc["total"].as<double>();
+        });
+        sp.plug->saveEnergy();
+        CHECK(total == doctest::Approx(10).epsilon(0.001));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("load step events") {
+        SimPlug sp;
+        int notified = 0;
+        uint32_t since = 0;
+        sp.settings->onChangedProperties([&notified, &since](PropertyNode& props) {
+            if (props.changed() <= since) return;
+
+            uint8_t buffer[Settings::JSON_STATE_SIZE];
+            PrintBuffer out{buffer, sizeof(buffer)};
+            props.printJson(out, 0, since);
+            since = Property::generation();
+
+            DynamicJsonDocument doc{Settings::JSON_STATE_SIZE};
+            REQUIRE(DeserializationError::Ok == deserializeJson(doc, buffer, out.length()));
+            if (!doc["events"].isNull()) ++notified;
+        });
+
+        sp.sim.setVoltage(230);
+        sp.sim.setPower(60);
+        sp.run(30000);
+        const auto count = sp.state("events", "count"); // may include the load appearing at boot
+
+        // steady load stays quiet, a step is notified once
+        notified = 0;
+        sp.run(30000);
+        CHECK(sp.state("events", "count") == count);
+        sp.sim.setPower(1200);
+        sp.run(10000);
+        CHECK(sp.state("events", "count") == count + 1);
+        CHECK(notified == 1);
+
+        DynamicJsonDocument doc{2 * Settings::JSON_STATE_SIZE};
+        sp.settings->toJson(doc);
+        CHECK(doc["events"]["last"]["before"].as<float>() == doctest::Approx(60).epsilon(0.02));
+        CHECK(doc["events"]["last"]["after"].as<float>() == doctest::Approx(1200).epsilon(0.02));
+        CHECK(doc["events"]["last"]["duration"].as<unsigned>() >= 28);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("load switching off") {
+        SimPlug sp;
+        sp.sim.setVoltage(230);
+        sp.sim.setPower(1200);
+        sp.run(30000);
+        CHECK(sp.state("power") == doctest::Approx(1200).epsilon(0.02));
+        const auto count = sp.state("events", "count");
+
+        // pulses stop altogether, power falls away rather than holding
+        sp.sim.setPower(0);
+        sp.run(10000);
+        CHECK(sp.state("power") < 1);
+        CHECK(sp.state("events", "count") == count + 1);
+
+        DynamicJsonDocument doc{2 * Settings::JSON_STATE_SIZE};
+        sp.settings->toJson(doc);
+        CHECK(doc["events"]["last"]["before"].as<float>() == doctest::Approx(1200).epsilon(0.02));
+        CHECK(doc["events"]["last"]["after"].as<float>() < 5);
+
+        // and reaches zero (within the deadband of the lowered readings)
+        sp.run(60000);
+        CHECK(sp.state("power") == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("overpower") {
+        SimPlug sp;
+        {
+            DynamicJsonDocument param{Settings::JSON_REQUEST_SIZE};
+            param["limit"] = 1000;
+            DynamicJsonDocument result{256};
+            CHECK(sp.settings->call("protect", param.as<JsonObject>(), result) == JsonRpcError::NO_ERROR);
+        }
+        CHECK(sp.settings->setRelay(true));
+        CHECK(sp.sim.level(SmartPlug::PIN_RELAY));
+
+        sp.sim.setVoltage(230);
+        sp.sim.setPower(900);
+        sp.run(1000);
+        CHECK(sp.sim.level(SmartPlug::PIN_RELAY));
+
+        // ISR opens the relay within a few ms, without tick()
+        sp.sim.setPower(1500);
+        sp.run(20, 100000);
+        CHECK(false == sp.sim.level(SmartPlug::PIN_RELAY));
+        CHECK(sp.settings->relay());
+
+        // then tick() records and latches the fault
+        sp.run(10);
+        CHECK(sp.settings->protectFault());
+        CHECK(false == sp.settings->relay());
+        CHECK(sp.state("protect", "trips") == 1);
+        CHECK(sp.state("protect", "tripPower") == doctest::Approx(1500).epsilon(0.01));
+
+        CHECK(false == sp.settings->setRelay(true));
+        CHECK(false == sp.sim.level(SmartPlug::PIN_RELAY));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("replay trace") {
+        Hlw8012Sim::Edges edges;
+        {
+            SimPlug sp;
+            sp.sim.setVoltage(230);
+            sp.sim.setPower(300);
+            sp.run(100);
+
+            CHECK(sp.plug->startTrace(PulseTrace::CAPACITY));
+            while (sp.plug->trace().capturing()) sp.run(100);
+            edges = traceEdges(sp.plug->trace());
+        }
+        REQUIRE(edges.size() == PulseTrace::CAPACITY);
+
+        // recorded edges reproduce the reading
+        SimPlug sp;
+        sp.sim.replay(edges, [&sp]() {
+            sp.settings->tick();
+            sp.plug->tick();
+        });
+        sp.run(200); // publish (no further edges)
+        CHECK(sp.state("power") == doctest::Approx(300).epsilon(0.015));
+        CHECK(sp.state("voltage") == doctest::Approx(230).epsilon(0.005));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("benchmark") {
+        SimPlug sp;
+        sp.sim.setVoltage(230);
+        sp.sim.setPower(2000);
+
+        const auto start = std::chrono::steady_clock::now();
+        sp.run(60000);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        using Seconds = std::chrono::duration<double>;
+        const auto edgesPerSecond = sp.sim.edges() / Seconds(elapsed).count();
+
+        CHECK(sp.overflows() == 0);
+        CHECK(sp.state("power") == doctest::Approx(2000).epsilon(0.015));
+        MESSAGE(sp.sim.edges() << " edges, " << edgesPerSecond << " edges/s (ISR + tick)");
+    }
+}
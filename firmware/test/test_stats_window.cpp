@@ -0,0 +1,71 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test windowed statistics
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "print_buffer.h"
+#include "stats_window.h"
+#include <string>
+
+namespace {
+    /// properties changed since a generation as a JSON string, moving since on
+    std::string changesJson(PropertyNode& root, uint32_t& since) {
+        uint8_t buffer[2048];
+        PrintBuffer out{buffer, sizeof(buffer)};
+        root.printJson(out, 0, since);
+        since = Property::generation();
+        return std::string{reinterpret_cast<const char*>(buffer), out.length()};
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("StatsWindow") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("publishes as window closes") {
+        PropertyNode root;
+        StatsWindow window{ &root, "w", 4 };
+        CHECK(window.seconds() == 4);
+        uint32_t since = Property::generation();
+
+        window.add(1, 120);
+        window.add(3, 121);
+        window.add(1, 120);
+        CHECK(root.changed() <= since);
+
+        window.add(3, 121);
+        CHECK(root.changed() > since);
+        CHECK(changesJson(root, since) == R"({"w":{"power":{"min":1,"max":3,"mean":2,"stddev":1},"voltage":{"min":120,"max":121,"mean":120.5,"stddev":0.5}}})");
+
+        // changed aggregates are published whole
+        for (int i = 0; i < 4; ++i) window.add(2, 120);
+        CHECK(changesJson(root, since) == R"({"w":{"power":{"min":2,"max":2,"mean":2,"stddev":0},"voltage":{"min":120,"max":120,"mean":120,"stddev":0}}})");
+
+        // unchanged aggregates aren't
+        for (int i = 0; i < 4; ++i) window.add(2, 120);
+        CHECK(root.changed() <= since);
+        for (int i = 0; i < 4; ++i) window.add(2, 121);
+        CHECK(changesJson(root, since) == R"({"w":{"voltage":{"min":121,"max":121,"mean":121,"stddev":0}}})");
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("setSeconds") {
+        PropertyNode root;
+        StatsWindow window{ &root, "w", 3 };
+        window.add(10, 120);
+        window.add(10, 120);
+
+        // restarts window
+        window.setSeconds(2);
+        CHECK(window.seconds() == 2);
+        const auto since = Property::generation();
+        window.add(10, 120);
+        CHECK(root.changed() <= since);
+        window.add(30, 120);
+        CHECK(root.changed() > since);
+    }
+}
@@ -0,0 +1,110 @@
+/////////////////////////////////////////////////////////////////////////////
+/** @file
+Test load step detection
+
+\copyright Copyright (c) 2018 Chris Byrne. All rights reserved.
+Licensed under the MIT License. Refer to LICENSE file in the project root. */
+/////////////////////////////////////////////////////////////////////////////
+
+//- includes
+#include "doctest_ext.h"
+#include "step_detector.h"
+#include <vector>
+
+namespace {
+    /// feed samples at a level, alternating by +/- noise
+    /// @returns number of steps detected
+    int feed(StepDetector& detector, uint32_t& now, uint32_t seconds, float watts, float noise = 0) {
+        int steps = 0;
+        for (uint32_t i = 0; i < seconds; ++i, ++now) {
+            const auto jitter = (i & 1) ? noise : -noise;
+            if (detector.add(watts + jitter, now)) ++steps;
+        }
+        return steps;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+TEST_SUITE("StepDetector") {
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("on/off") {
+        StepDetector detector;
+        uint32_t now = 1000000;
+        CHECK(feed(detector, now, 600, 100, 2) == 0);
+        CHECK(detector.end() == 0);
+
+        // switching on, the first sample straddles the step
+        CHECK(false == detector.add(800, now++));
+        CHECK(detector.add(1500, now++));
+        REQUIRE(detector.end() == 1);
+        const auto& on = detector.at(0);
+        CHECK(on.time == 1000600);
+        CHECK(on.duration == 600);
+        CHECK(on.before == doctest::Approx(100).epsilon(0.01));
+        CHECK(on.after == doctest::Approx(1500));
+
+        // steady, then off
+        CHECK(feed(detector, now, 300, 1500, 10) == 0);
+        CHECK(detector.level() == doctest::Approx(1500).epsilon(0.01));
+        CHECK(feed(detector, now, 10, 100) == 1);
+        REQUIRE(detector.end() == 2);
+        const auto& off = detector.at(1);
+        CHECK(off.time == 1000902);
+        CHECK(off.duration == 302);
+        CHECK(off.before == doctest::Approx(1500).epsilon(0.01));
+        CHECK(off.after == doctest::Approx(100));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("noise and drift") {
+        StepDetector detector;
+        uint32_t now = 0;
+        CHECK(feed(detector, now, 600, 50, 3) == 0);
+
+        // slow drift is followed
+        for (int i = 0; i < 600; ++i) CHECK(false == detector.add(50 + i / 60.0f, now++));
+        CHECK(detector.level() == doctest::Approx(60).epsilon(0.02));
+        CHECK(detector.end() == 0);
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("small steps") {
+        StepDetector detector;
+        uint32_t now = 0;
+        CHECK(feed(detector, now, 60, 2) == 0);
+
+        // shifts within half the smallest step are ignored
+        CHECK(feed(detector, now, 600, 4) == 0);
+        CHECK(feed(detector, now, 60, 2) == 0);
+
+        // a phone charger is picked up within a few seconds
+        const auto start = now;
+        CHECK(feed(detector, now, 5, 9) == 1);
+        REQUIRE(detector.end() == 1);
+        CHECK(detector.at(0).time == start);
+        CHECK(detector.at(0).duration == start);
+        CHECK(detector.at(0).after == doctest::Approx(9));
+    }
+
+    /////////////////////////////////////////////////////////////////////////
+    TEST_CASE("ring") {
+        StepDetector detector;
+        uint32_t now = 1000;
+        for (int i = 0; i < 40; ++i) CHECK(feed(detector, now, 10, (i & 1) ? 0 : 100) == ((0 == i) ? 0 : 1));
+        CHECK(detector.end() == 39);
+        CHECK(detector.begin() == 39 - StepDetector::EVENTS);
+
+        std::vector<uint32_t> seqs;
+        detector.read(0, 100, [&seqs](uint32_t seq, const StepDetector::Event& event) {
+            CHECK(event.duration == 10);
+            seqs.push_back(seq);
+        });
+        REQUIRE(seqs.size() == StepDetector::EVENTS);
+        CHECK(seqs.front() == detector.begin());
+        CHECK(seqs.back() == 38);
+
+        seqs.clear();
+        detector.read(30, 2, [&seqs](uint32_t seq, const StepDetector::Event&) { seqs.push_back(seq); });
+        CHECK(seqs == std::vector<uint32_t>{ 30, 31 });
+    }
+}
@@ -35,6 +35,11 @@ export default function(store: any) {
     }
     lastGitRevision = data.gitRev;
 
+    // seed wattage from the device's history
+    rpcSocket.request('history', { count: 60 }).then((history: any) => {
+      store.commit('Rpc/wattageHistory', history);
+    }).catch(() => { /* older firmware */ });
+
     // start logging Wattage
     const timerId = setInterval(() => {
       if (!rpcSocket.connected) {
@@ -102,6 +107,18 @@ export default function(store: any) {
         // console.log('connectionUpdate', state, data);
         mergeDeep(state.data, data);
       },
+      wattageHistory(state: any, history: any) {
+        // newest sample is approximately now
+        const now = Date.now();
+        const samples = history.power.map((p: number, i: number) => [
+          new Date(now - (history.end - 1 - (history.start + i)) * history.interval * 1000),
+          p * history.scale,
+        ]);
+        state.wattage = [
+          ...state.wattage.slice(samples.length),
+          ...samples,
+        ];
+      },
       wattage(state: any, power: number) {
         state.wattage = [
           ...state.wattage.slice(1),